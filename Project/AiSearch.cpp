@@ -0,0 +1,192 @@
+#include "AiSearch.h"
+
+#include "EngineCounters.h"
+#include "Profiler.h"
+
+namespace
+{
+   // Clears, falls and refills after a move finish well within this, it only guards against a board that never settles
+   constexpr int max_settle_steps = 256;
+   // Share of the memory cap given to tree nodes, the rest holds board snapshots
+   constexpr size_t node_share_divisor = 4;
+
+   // Depth 0 never looks ahead, so it needs no search memory at all
+   size_t MemoryCapBytes(const GameSettings* settings)
+   {
+      if (settings->ai_search_depth <= 0)
+         return 0;
+      const int megabytes = settings->ai_memory_cap_mb > 0 ? settings->ai_memory_cap_mb : 1;
+      return static_cast<size_t>(megabytes) * 1024 * 1024;
+   }
+}
+
+AiSearch::AiSearch(GameSettings* settings)
+   : depth_(settings->ai_search_depth > 0 ? settings->ai_search_depth : 0),
+     board_(settings),
+     arena_(MemoryCapBytes(settings) - MemoryCapBytes(settings) / node_share_divisor),
+     nodes_(MemoryCapBytes(settings) / node_share_divisor / sizeof(SearchNode))
+{
+   board_.g_print_ai_moves = false;
+   board_.is_search_board = true;
+   // Sizes board_ up front so the first search doesn't allocate, Restore overwrites every cell anyway
+   board_.GeneratePlayField(settings->world_size.x, settings->world_size.y, settings->cell_types_used);
+}
+
+/// <summary>
+/// Searches depth_ moves ahead from the board's current state. The board itself is only read, every move is played out on board_.
+/// Refills come from the snapshot's random state, so what the search sees is exactly what the real board will do.
+/// </summary>
+bool AiSearch::FindMove(const Match3& board, IVec2 move[2])
+{
+   PROFILE_SCOPE("AI Search");
+   // board_ runs hundreds of ProgressGames per search, keep them out of the trace
+   PROFILE_SUSPEND();
+
+   arena_.Reset();
+   snapshot_size_ = board.GetSnapshotSize();
+   auto* root = static_cast<uint8_t*>(arena_.Allocate(snapshot_size_, alignof(Match3State)));
+   if (!root)
+   {
+      last_search_capped_ = true;
+      return false;
+   }
+   board.Snapshot(root);
+   return Search(root, move);
+}
+
+bool AiSearch::FindMoveAfterSettling(const uint8_t* snapshot, uint8_t* settled, IVec2 move[2])
+{
+   PROFILE_SCOPE("AI Search");
+   PROFILE_SUSPEND();
+
+   board_.Restore(snapshot);
+   SettleBoard();
+   board_.Snapshot(settled);
+
+   arena_.Reset();
+   snapshot_size_ = board_.GetSnapshotSize();
+   return Search(settled, move);
+}
+
+// Searches from root, which the caller keeps alive for the whole search
+bool AiSearch::Search(const uint8_t* root, IVec2 move[2])
+{
+   nodes_.Reset();
+   last_node_count_ = 0;
+   last_search_capped_ = false;
+
+   if (depth_ == 0)
+   {
+      board_.Restore(root);
+      return board_.AnyLegalMatchesExist(move);
+   }
+
+   const SearchNode* best = SearchMoves(root, depth_);
+   EngineCounters::Add(EngineCounter::AiNodes, last_node_count_);
+   if (IsCancelled())
+      return false;
+   if (!best)
+   {
+      // Cut short by the memory cap before it found anything, the first legal move is still better than none
+      if (!last_search_capped_)
+         return false;
+      board_.Restore(root);
+      return board_.AnyLegalMatchesExist(move);
+   }
+
+   move[Match3::CellMove::FROM] = best->from;
+   move[Match3::CellMove::TO] = best->to;
+   return true;
+}
+
+/// <summary> Tries every right and down swap from state, keeping only the best scoring line. </summary>
+/// <returns>The best move, or nullptr if no swap makes a match</returns>
+AiSearch::SearchNode* AiSearch::SearchMoves(const uint8_t* state, const int depth)
+{
+   const size_t marker = arena_.GetMarker();
+   // One snapshot per level, reused by each move as it is searched deeper
+   uint8_t* childState = nullptr;
+   if (depth > 1)
+   {
+      childState = static_cast<uint8_t*>(arena_.Allocate(snapshot_size_, alignof(Match3State)));
+      if (!childState)
+         last_search_capped_ = true;
+   }
+
+   const Match3State* header = reinterpret_cast<const Match3State*>(state);
+   const int width = header->rules.world_width;
+   const int height = header->rules.world_height;
+
+   SearchNode* best = nullptr;
+   for (int y = 0; y < height && !IsCancelled(); y++)
+   {
+      for (int x = 0; x < width; x++)
+      {
+         SearchNode* candidates[2] = {
+            x + 1 < width ? TryMove(state, childState, IVec2(x, y), IVec2(x + 1, y), depth) : nullptr,
+            y + 1 < height ? TryMove(state, childState, IVec2(x, y), IVec2(x, y + 1), depth) : nullptr
+         };
+         for (SearchNode* candidate : candidates)
+         {
+            if (!candidate)
+               continue;
+            if (!best || candidate->score > best->score)
+            {
+               ReleaseLine(best);
+               best = candidate;
+            }
+            else
+               ReleaseLine(candidate);
+         }
+      }
+   }
+
+   arena_.Rewind(marker);
+   return best;
+}
+
+/// <summary> Plays a single swap out on board_ from state and, with depth left, searches on from where it settles. </summary>
+/// <returns>The move's node, or nullptr if the swap doesn't match or the pool is empty</returns>
+AiSearch::SearchNode* AiSearch::TryMove(const uint8_t* state, uint8_t* child_state, const IVec2 from, const IVec2 to, const int depth)
+{
+   board_.Restore(state);
+   const int scoreBefore = board_.g_extraInfo.game_score;
+   if (!board_.Step(from, to))
+      return nullptr;
+   SettleBoard();
+   last_node_count_++;
+
+   SearchNode* node = nodes_.Acquire(from, to, board_.g_extraInfo.game_score - scoreBefore, nullptr);
+   if (!node)
+   {
+      last_search_capped_ = true;
+      return nullptr;
+   }
+
+   if (depth > 1 && child_state)
+   {
+      board_.Snapshot(child_state);
+      node->best_child = SearchMoves(child_state, depth - 1);
+      if (node->best_child)
+         node->score += node->best_child->score;
+   }
+   return node;
+}
+
+// Progresses board_ the same way FixedUpdate would until it is waiting for the next move
+void AiSearch::SettleBoard()
+{
+   for (int i = 0; i < max_settle_steps && !board_.IsReadyForMove(); i++)
+      board_.ProgressGame();
+}
+
+// Hands a node and the line below it back to the pool
+void AiSearch::ReleaseLine(SearchNode* node)
+{
+   while (node)
+   {
+      SearchNode* child = node->best_child;
+      nodes_.Release(node);
+      node = child;
+   }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "ArenaAllocator.h"
+#include "IVec2.h"
+#include "Match3.h"
+#include "NodePool.h"
+
+/// <summary>
+/// Looks a number of moves ahead by playing every swap out on a scratch board, restored from snapshots, and picks the line that scores the most.
+/// Snapshots come from an arena and tree nodes from a pool, both sized from GameSettings::ai_memory_cap_mb when the search is created,
+/// so a search never touches the heap and is dropped in one go before the next. When either runs out the search stops going deeper.
+/// A depth of 0 doesn't look ahead, it plays the first legal move like Match3::AnyLegalMatchesExist finds it.
+/// </summary>
+class AiSearch
+{
+public:
+   explicit AiSearch(GameSettings* settings);
+   AiSearch(const AiSearch&) = delete;
+   AiSearch& operator=(const AiSearch&) = delete;
+
+   // Fills move with the best scoring swap, returns false if the board has no legal moves
+   bool FindMove(const Match3& board, IVec2 move[2]);
+   // Plays snapshot on until it is waiting for a move, writes that state to settled (GetSnapshotSize bytes) and searches from there.
+   // Works on a board that is still clearing and refilling, so the next move can be ready before the real board settles.
+   bool FindMoveAfterSettling(const uint8_t* snapshot, uint8_t* settled, IVec2 move[2]);
+
+   // Checked as the search goes, a search that sees it set gives up and returns false. Null to never cancel.
+   void SetCancelFlag(const std::atomic<bool>* cancel) { cancel_ = cancel; }
+
+   // Nodes the last search looked at, and whether it hit the memory cap
+   uint64_t LastNodeCount() const { return last_node_count_; }
+   bool LastSearchCapped() const { return last_search_capped_; }
+
+private:
+   struct SearchNode
+   {
+      IVec2 from;
+      IVec2 to;
+      // Points this move scores plus the best of what follows it
+      int score;
+      SearchNode* best_child;
+   };
+
+   bool Search(const uint8_t* root, IVec2 move[2]);
+   bool IsCancelled() const { return cancel_ && cancel_->load(std::memory_order_relaxed); }
+   SearchNode* SearchMoves(const uint8_t* state, int depth);
+   SearchNode* TryMove(const uint8_t* state, uint8_t* child_state, IVec2 from, IVec2 to, int depth);
+   void SettleBoard();
+   void ReleaseLine(SearchNode* node);
+
+   int depth_;
+   Match3 board_;
+   ArenaAllocator arena_;
+   NodePool<SearchNode> nodes_;
+   size_t snapshot_size_ = 0;
+   const std::atomic<bool>* cancel_ = nullptr;
+
+   uint64_t last_node_count_ = 0;
+   bool last_search_capped_ = false;
+};
@@ -0,0 +1,98 @@
+#include "AiWorker.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+AiWorker::AiWorker(GameSettings* settings, const Match3& board)
+   : search_(settings),
+     job_state_(board.GetSnapshotSize()),
+     result_settled_(board.GetSnapshotSize()),
+     work_state_(board.GetSnapshotSize()),
+     work_settled_(board.GetSnapshotSize())
+{
+   search_.SetCancelFlag(&cancel_);
+   thread_ = std::thread(&AiWorker::WorkerLoop, this);
+}
+
+AiWorker::~AiWorker()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_stopping_ = true;
+      cancel_.store(true, std::memory_order_relaxed);
+   }
+   job_changed_.notify_one();
+   thread_.join();
+}
+
+void AiWorker::Submit(const Match3& board)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Only a different sized board changes this
+      job_state_.resize(board.GetSnapshotSize());
+      board.Snapshot(job_state_.data());
+      job_id_++;
+      cancel_.store(true, std::memory_order_relaxed);
+   }
+   job_changed_.notify_one();
+}
+
+AiWorker::Result AiWorker::TakeMove(const Match3& board, IVec2 move[2])
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (result_id_ != job_id_)
+      return Result::Searching;
+
+   if (result_id_ == 0 || !board.HasSameBoard(result_settled_.data()))
+   {
+      mispredictions_++;
+      return Result::Mispredicted;
+   }
+   if (!result_has_move_)
+      return Result::NoMove;
+
+   move[Match3::CellMove::FROM] = result_move_[Match3::CellMove::FROM];
+   move[Match3::CellMove::TO] = result_move_[Match3::CellMove::TO];
+   return Result::Move;
+}
+
+void AiWorker::WorkerLoop()
+{
+   PROFILE_THREAD_NAME("AI Worker");
+   uint64_t workingId = 0;
+   while (true)
+   {
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         job_changed_.wait(lock, [&] { return is_stopping_ || job_id_ != workingId; });
+         if (is_stopping_)
+            return;
+         workingId = job_id_;
+         work_state_.resize(job_state_.size());
+         work_settled_.resize(job_state_.size());
+         std::copy(job_state_.begin(), job_state_.end(), work_state_.begin());
+         cancel_.store(false, std::memory_order_relaxed);
+      }
+
+      IVec2 move[2];
+      const bool hasMove = search_.FindMoveAfterSettling(work_state_.data(), work_settled_.data(), move);
+
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         // A newer Submit came in while searching, its job is picked up on the next loop
+         if (workingId != job_id_)
+            cancelled_searches_.fetch_add(1, std::memory_order_relaxed);
+         else
+         {
+            result_settled_.swap(work_settled_);
+            result_move_[Match3::CellMove::FROM] = move[Match3::CellMove::FROM];
+            result_move_[Match3::CellMove::TO] = move[Match3::CellMove::TO];
+            result_has_move_ = hasMove;
+            result_id_ = workingId;
+         }
+      }
+      PROFILE_END_FRAME();
+   }
+}
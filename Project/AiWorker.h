@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AiSearch.h"
+#include "IVec2.h"
+#include "Match3.h"
+
+/// <summary>
+/// Runs the AI's search on its own thread, so the move is usually ready by the time the board is.
+/// The simulation Submits the board as soon as a move or reset has been applied. Clearing, falling and refilling only depend
+/// on the board and its random state, so the worker plays the cascade out on its own copy to predict the board the
+/// move will be made on, and searches that while the real board is still settling.
+/// A new Submit cancels whatever the worker was doing. TakeMove checks the prediction against the real board before using it,
+/// and never waits for the worker, so the simulation thread is never held up by a search.
+/// </summary>
+class AiWorker
+{
+public:
+   enum class Result { Move, NoMove, Mispredicted, Searching };
+
+   // board is only used for its size, the worker doesn't search anything until the first Submit
+   AiWorker(GameSettings* settings, const Match3& board);
+   ~AiWorker();
+   AiWorker(const AiWorker&) = delete;
+   AiWorker& operator=(const AiWorker&) = delete;
+
+   // Simulation thread. Starts predicting and searching from the board as it is now.
+   void Submit(const Match3& board);
+   // Simulation thread, call once board is ready for a move. Searching means the last Submit's search hasn't finished,
+   // which only happens when the board settled faster than the search (turbo), poll again on a later step.
+   // Mispredicted means the settled board isn't the one that was searched, Submit again to search the board as it is.
+   Result TakeMove(const Match3& board, IVec2 move[2]);
+
+   // Searches thrown away because a newer Submit came in, or because the prediction was wrong
+   uint64_t CancelledSearches() const { return cancelled_searches_.load(std::memory_order_relaxed); }
+   uint64_t Mispredictions() const { return mispredictions_; }
+
+private:
+   void WorkerLoop();
+
+   AiSearch search_;
+   std::thread thread_;
+
+   // Guards everything below down to the worker's own buffers
+   std::mutex mutex_;
+   std::condition_variable job_changed_;
+   bool is_stopping_ = false;
+   // Each Submit gets the next id, result_id_ is the job the result buffers belong to
+   uint64_t job_id_ = 0;
+   uint64_t result_id_ = 0;
+   std::vector<uint8_t> job_state_;
+   std::vector<uint8_t> result_settled_;
+   IVec2 result_move_[2];
+   bool result_has_move_ = false;
+   // Set by Submit to stop a search that is already out of date
+   std::atomic<bool> cancel_{ false };
+
+   // Worker thread only
+   std::vector<uint8_t> work_state_;
+   std::vector<uint8_t> work_settled_;
+
+   std::atomic<uint64_t> cancelled_searches_{ 0 };
+   // Simulation thread only
+   uint64_t mispredictions_ = 0;
+};
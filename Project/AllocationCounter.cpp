@@ -0,0 +1,76 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+   std::atomic<uint64_t> g_total_allocations{ 0 };
+   std::atomic<uint64_t> g_total_bytes{ 0 };
+   // Plain integer, initialised without allocating so it is safe to use from inside operator new
+   thread_local uint64_t t_thread_allocations = 0;
+
+   void* Allocate(const size_t size)
+   {
+      AllocationCounter::Record(size);
+      // malloc(0) may return null, operator new has to return a unique pointer
+      void* memory = malloc(size == 0 ? 1 : size);
+      if (!memory)
+         throw std::bad_alloc();
+      return memory;
+   }
+}
+
+uint64_t AllocationCounter::Total()
+{
+   return g_total_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::TotalBytes()
+{
+   return g_total_bytes.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::ThisThread()
+{
+   return t_thread_allocations;
+}
+
+void AllocationCounter::Record(const size_t size)
+{
+   t_thread_allocations++;
+   g_total_allocations.fetch_add(1, std::memory_order_relaxed);
+   g_total_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+// Array, nothrow and sized forms all end up here or in the matching delete by default, aligned new is left alone
+void* operator new(const size_t size)
+{
+   return Allocate(size);
+}
+
+void* operator new[](const size_t size)
+{
+   return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+   free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+   free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+   free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+   free(memory);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Counts every heap allocation made through operator new, replaced in AllocationCounter.cpp.
+/// Counts are kept per thread as well, so a frame or a tick can be checked for allocations without other threads getting in the way.
+/// </summary>
+class AllocationCounter
+{
+public:
+   // Every thread since startup
+   static uint64_t Total();
+   static uint64_t TotalBytes();
+   // Allocations made by the calling thread
+   static uint64_t ThisThread();
+
+   // Called by the replaced operator new
+   static void Record(size_t size);
+};
+
+/// <summary> Allocations made by this thread while the scope is alive. </summary>
+class ScopedAllocationCount
+{
+public:
+   ScopedAllocationCount() : start_(AllocationCounter::ThisThread()) { }
+   uint64_t Count() const { return AllocationCounter::ThisThread() - start_; }
+
+private:
+   uint64_t start_;
+};
@@ -0,0 +1,40 @@
+#include "ArenaAllocator.h"
+
+#include <cstdio>
+
+ArenaAllocator::ArenaAllocator(const size_t capacity)
+{
+   memory_ = new (std::nothrow) uint8_t[capacity];
+   if (!memory_)
+   {
+      printf("Failed to reserve %zu bytes for an arena\n", capacity);
+      return;
+   }
+   capacity_ = capacity;
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+   delete[] memory_;
+}
+
+void* ArenaAllocator::Allocate(const size_t size, const size_t alignment)
+{
+   // Alignment has to be a power of two, which alignof always is
+   const size_t start = (used_ + alignment - 1) & ~(alignment - 1);
+   if (start + size > capacity_)
+   {
+      failed_allocations_++;
+      return nullptr;
+   }
+   used_ = start + size;
+   if (used_ > high_water_)
+      high_water_ = used_;
+   return memory_ + start;
+}
+
+void ArenaAllocator::Rewind(const size_t marker)
+{
+   if (marker < used_)
+      used_ = marker;
+}
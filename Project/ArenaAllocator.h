@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+/// <summary>
+/// Bump allocator over a single block reserved up front, nothing is freed individually.
+/// Reset (or Rewind to a marker) throws everything allocated since away at once, so a whole search can be dropped in one go.
+/// Allocations past the capacity return nullptr instead of growing, which is what caps a search's memory.
+/// Not thread safe, each searcher owns its own arena so parallel searches never contend on the heap.
+/// </summary>
+class ArenaAllocator
+{
+public:
+   explicit ArenaAllocator(size_t capacity);
+   ~ArenaAllocator();
+   ArenaAllocator(const ArenaAllocator&) = delete;
+   ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+   // Null once the arena is full
+   void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+   template <typename T>
+   T* AllocateArray(const size_t count)
+   {
+      static_assert(std::is_trivially_destructible<T>::value, "Arena memory is dropped without running destructors");
+      return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+   }
+
+   // Everything allocated after GetMarker is released by Rewind, allocations before it are kept
+   size_t GetMarker() const { return used_; }
+   void Rewind(size_t marker);
+   void Reset() { Rewind(0); }
+
+   size_t Used() const { return used_; }
+   size_t Capacity() const { return capacity_; }
+   // Most ever used at once, shows how close searches get to the cap
+   size_t HighWater() const { return high_water_; }
+   uint64_t FailedAllocations() const { return failed_allocations_; }
+
+private:
+   uint8_t* memory_ = nullptr;
+   size_t capacity_ = 0;
+   size_t used_ = 0;
+   size_t high_water_ = 0;
+   uint64_t failed_allocations_ = 0;
+};
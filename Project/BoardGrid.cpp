@@ -0,0 +1,95 @@
+#include "BoardGrid.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+BoardGrid::BoardGrid(GameSettings* settings, Match3* first_board)
+{
+   game_settings_ = settings;
+   const int boardCount = std::max(1, settings->monitor_boards);
+   boards_.reserve(boardCount);
+   boards_.push_back(first_board);
+   for (int i = 1; i < boardCount; i++)
+   {
+      extra_boards_.push_back(std::make_unique<Match3>(settings));
+      boards_.push_back(extra_boards_.back().get());
+   }
+   if (settings->ai_search_depth > 0)
+      search_ = std::make_unique<AiSearch>(settings);
+
+   // Most columns the grid can have while still fitting the board's aspect on screen, each board plus a cell of spacing
+   const float tileWidth = static_cast<float>(settings->world_size.x + 1);
+   const float tileHeight = static_cast<float>(settings->world_size.y + 1);
+   float bestScale = 0.0f;
+   for (int columns = 1; columns <= boardCount; columns++)
+   {
+      const int rows = (boardCount + columns - 1) / columns;
+      const float scale = std::min(settings->screen_size.x / (columns * tileWidth), settings->screen_size.y / (rows * tileHeight));
+      if (scale > bestScale)
+      {
+         bestScale = scale;
+         columns_ = columns;
+      }
+   }
+}
+
+void BoardGrid::Start()
+{
+   const GameRules* rules = boards_[0]->GetRules();
+   for (size_t i = 0; i < extra_boards_.size(); i++)
+   {
+      Match3& board = *extra_boards_[i];
+      board.g_print_ai_moves = false;
+      board.Reseed(boards_[0]->GetSeed() + static_cast<Uint32>(i) + 1);
+      board.GeneratePlayField(rules->world_width, rules->world_height, game_settings_->cell_types_used);
+   }
+}
+
+void BoardGrid::FixedUpdate()
+{
+   PROFILE_SCOPE("BoardGrid::FixedUpdate");
+   // The first board is updated by the game like any other
+   const size_t boardCount = extra_boards_.size();
+   size_t firstWaiting = boardCount;
+   int searches = 0;
+   for (size_t n = 0; n < boardCount; n++)
+   {
+      // Starts from the board the last step's searches ran out on, so every board gets its turn
+      const size_t index = (next_search_board_ + n) % boardCount;
+      Match3& board = *extra_boards_[index];
+      // Played before the board steps, the same as a Player's move applied at the start of a fixed step
+      if (board.IsReadyForMove())
+      {
+         if (!search_ || searches < max_searches_per_step)
+         {
+            PlayMove(board);
+            searches++;
+         }
+         else if (firstWaiting == boardCount)
+            firstWaiting = index;
+      }
+      board.FixedUpdate();
+   }
+   if (firstWaiting != boardCount)
+      next_search_board_ = firstWaiting;
+}
+
+void BoardGrid::PlayMove(Match3& board)
+{
+   IVec2 move[2];
+   // A search cut short by its memory cap may find nothing, the first legal move is still better than none
+   if ((search_ && search_->FindMove(board, move)) || board.AnyLegalMatchesExist(move))
+      board.ApplyCommand(Command::MakeSwap(move[Match3::CellMove::FROM], move[Match3::CellMove::TO]));
+}
+
+void BoardGrid::Capture(BoardSnapshot& snapshot, const Uint32 sequence) const
+{
+   snapshot.CaptureGrid(boards_.data(), BoardCount(), columns_, sequence);
+}
+
+void BoardGrid::ClearChangedCells()
+{
+   for (Match3* board : boards_)
+      board->ClearChangedCells();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "AiSearch.h"
+#include "BoardSnapshot.h"
+#include "GameObject.h"
+#include "Match3.h"
+
+/// <summary>
+/// Monitor view, plays GameSettings::monitor_boards games side by side for watching batch runs.
+/// The game's own board is the first, played by the Player as usual, the rest are owned here and played by the AI every fixed step.
+/// Extra boards are seeded one after another from the first board's seed, so a seeded run plays the same games every time.
+/// Columns are picked so the grid fills as much of the screen as it can.
+/// Searches run on the simulation thread, so only max_searches_per_step boards look ahead each fixed step, the rest wait their turn.
+/// </summary>
+class BoardGrid : public GameObject
+{
+public:
+   BoardGrid(GameSettings* settings, Match3* first_board);
+   BoardGrid(const BoardGrid&) = delete;
+   BoardGrid& operator=(const BoardGrid&) = delete;
+
+   // Call after the first board has started, the rest are generated the same size
+   void Start() override;
+   void FixedUpdate() override;
+
+   // Copies every board into snapshot, laid out in the grid
+   void Capture(BoardSnapshot& snapshot, Uint32 sequence) const;
+   // Call once the changed cells have been published, like Match3::ClearChangedCells
+   void ClearChangedCells();
+
+   int BoardCount() const { return static_cast<int>(boards_.size()); }
+   int Columns() const { return columns_; }
+   // Board 0 is the game's own board
+   const Match3& GetBoard(const int index) const { return *boards_[index]; }
+
+private:
+   void PlayMove(Match3& board);
+
+   // Lookahead searches per fixed step, a fixed step has to stay well inside its time however many boards are shown.
+   // Without lookahead a move is just the first legal one, cheap enough for every board to play each step.
+   static constexpr int max_searches_per_step = 2;
+
+   GameSettings* game_settings_;
+   // boards_[0] is the game's board, not owned
+   std::vector<Match3*> boards_;
+   std::vector<std::unique_ptr<Match3>> extra_boards_;
+   int columns_ = 1;
+   // Shared by every extra board, only created when GameSettings::ai_search_depth looks ahead
+   std::unique_ptr<AiSearch> search_;
+   // Index into extra_boards_ of the first board left waiting for a search last step
+   size_t next_search_board_ = 0;
+};
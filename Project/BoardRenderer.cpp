@@ -0,0 +1,471 @@
+#include "BoardRenderer.h"
+
+#include <algorithm>
+
+#include "Constants.h"
+#include "Profiler.h"
+#include "ShaderManager.h"
+#include "TextureUtility.h"
+
+BoardRenderer::BoardRenderer(GameSettings* settings)
+{
+   game_settings_ = settings;
+
+   glGenVertexArrays(1, &vao_);
+   glGenBuffers(1, &vbo_);
+   glGenBuffers(1, &ebo_);
+   glGenBuffers(1, &instance_vbo_);
+
+   glBindVertexArray(vao_);
+
+   glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+   // position attribute
+   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+   glEnableVertexAttribArray(0);
+   // texture coord attribute
+   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+   glEnableVertexAttribArray(1);
+
+   // Per instance animation, start and end positions, then start time, duration and start and end sizes
+   glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+   glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(CellInstance), (void*)offsetof(CellInstance, start_position));
+   glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(CellInstance), (void*)offsetof(CellInstance, start_time));
+   glVertexAttribIPointer(4, 1, GL_INT, sizeof(CellInstance), (void*)offsetof(CellInstance, easing));
+   // Per instance colour
+   glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(CellInstance), (void*)offsetof(CellInstance, colour));
+   for (int i = 2; i <= 5; i++)
+   {
+      glEnableVertexAttribArray(i);
+      glVertexAttribDivisor(i, 1);
+   }
+
+   glBindVertexArray(0);
+
+   // Texture mode
+   glGenVertexArrays(1, &empty_vao_);
+   glGenTextures(1, &board_texture_);
+}
+
+BoardRenderer::~BoardRenderer()
+{
+   glDeleteTextures(1, &board_texture_);
+   glDeleteVertexArrays(1, &empty_vao_);
+   glDeleteBuffers(1, &instance_vbo_);
+   glDeleteBuffers(1, &ebo_);
+   glDeleteBuffers(1, &vbo_);
+   glDeleteVertexArrays(1, &vao_);
+}
+
+// Uniforms can only be looked up once the program has linked, which may be a few frames in with parallel compile
+bool BoardRenderer::SetupWorldShader()
+{
+   if (is_world_shader_setup_)
+      return true;
+   if (!ShaderManager::Instance()->IsProgramReady(game_settings_->default_shader))
+      return false;
+
+   projection_location_ = glGetUniformLocation(game_settings_->default_shader, "projection");
+   time_location_ = glGetUniformLocation(game_settings_->default_shader, "time");
+   is_world_shader_setup_ = true;
+   return true;
+}
+
+bool BoardRenderer::SetupBoardShader()
+{
+   if (is_board_shader_setup_)
+      return true;
+   if (!ShaderManager::Instance()->IsProgramReady(game_settings_->board_shader))
+      return false;
+
+   const GLint boardShader = game_settings_->board_shader;
+   board_locations_.board_size = glGetUniformLocation(boardShader, "boardSize");
+   board_locations_.board_origin = glGetUniformLocation(boardShader, "boardOrigin");
+   board_locations_.cell_pitch = glGetUniformLocation(boardShader, "cellPitch");
+   board_locations_.cell_size = glGetUniformLocation(boardShader, "cellSize");
+   board_locations_.screen_height = glGetUniformLocation(boardShader, "screenHeight");
+   board_locations_.moved_from = glGetUniformLocation(boardShader, "movedFrom");
+   board_locations_.moved_to = glGetUniformLocation(boardShader, "movedTo");
+
+   // Palette and sampler never change
+   glm::vec4 palette[CELL_TYPE_COUNT];
+   for (int i = 0; i < CELL_TYPE_COUNT; i++)
+      palette[i] = GetCellColour(i);
+   glUseProgram(boardShader);
+   glUniform4fv(glGetUniformLocation(boardShader, "palette"), CELL_TYPE_COUNT, glm::value_ptr(palette[0]));
+   glUniform1i(glGetUniformLocation(boardShader, "board"), 0);
+
+   is_board_shader_setup_ = true;
+   return true;
+}
+
+bool BoardRenderer::Draw(Camera* camera, const BoardSnapshot& snapshot, const double simulation_time)
+{
+   PROFILE_SCOPE("BoardRenderer::Draw");
+   if (snapshot.cells.empty())
+      return false;
+
+   if (game_settings_->board_render_mode == BoardRenderMode::Texture && SetupBoardShader())
+      return DrawTexture(snapshot);
+   // Instanced cells stand in while the board shader is still compiling
+   if (SetupWorldShader())
+      return DrawInstanced(camera, snapshot, simulation_time);
+   return false;
+}
+
+bool BoardRenderer::CanApplyChangedCells(const BoardSnapshot& snapshot) const
+{
+   // Changed cells are relative to the previous snapshot, if we skipped any we can't trust them
+   return snapshot.sequence == drawn_sequence_ + 1 && snapshot.changed_cells.size() <= snapshot.cells.size() / 2;
+}
+
+BoardRenderer::Layout BoardRenderer::GetLayout(const IVec2 screen_size, const int width, const int height)
+{
+   const float cellSpacing = 32.0f;
+   const float cellExtraSpace = 16.0f;
+   Layout layout;
+   layout.origin = glm::vec2(cellExtraSpace, cellExtraSpace);
+   layout.cell_size = cell_screen_size;
+   layout.cell_pitch = layout.cell_size + cellSpacing;
+   const float fitScale = std::min(
+      (screen_size.x - cellExtraSpace * 2.0f) / (layout.cell_pitch * width),
+      (screen_size.y - cellExtraSpace * 2.0f) / (layout.cell_pitch * height));
+   if (fitScale < 1.0f)
+   {
+      layout.cell_pitch *= fitScale;
+      // Spacing is dropped once cells get down to a couple of pixels, otherwise most cells fall between pixels
+      layout.cell_size = (layout.cell_pitch < 2.0f ? layout.cell_pitch : layout.cell_size * fitScale);
+   }
+   return layout;
+}
+
+glm::vec4 BoardRenderer::GetCellColour(const int cell_type)
+{
+   // Colours are stored as 0xRRGGBBAA
+   const Uint32 colour = g_cell_colours[cell_type];
+   return glm::vec4(
+      ((colour >> 24) & 0xFF) / 255.0f,
+      ((colour >> 16) & 0xFF) / 255.0f,
+      ((colour >> 8) & 0xFF) / 255.0f,
+      (colour & 0xFF) / 255.0f);
+}
+
+bool BoardRenderer::DrawInstanced(Camera* camera, const BoardSnapshot& snapshot, const double simulation_time)
+{
+   const int cellCount = static_cast<int>(snapshot.cells.size());
+
+   // The moved cells are drawn larger, so they need updating when the highlight moves even if the cells did not
+   const IVec2 movedFrom = snapshot.extra_info.last_cell_moved_from;
+   const IVec2 movedTo = snapshot.extra_info.last_cell_moved_to;
+   const IVec2 highlights[4] = { drawn_moved_from_, drawn_moved_to_, movedFrom, movedTo };
+   const bool isHighlightMoved = (movedFrom != drawn_moved_from_ || movedTo != drawn_moved_to_);
+   drawn_moved_from_ = movedFrom;
+   drawn_moved_to_ = movedTo;
+
+   // Only touch the instance data if the board has changed since we last drew it
+   bool isAnimating = false;
+   if (static_cast<int>(instances_.size()) != cellCount)
+   {
+      ResizeInstances(cellCount);
+      RebuildInstances(snapshot, simulation_time);
+   }
+   else if (drawn_sequence_ != snapshot.sequence)
+   {
+      isAnimating = CanApplyChangedCells(snapshot);
+      // Too much changed to say where anything came from, like after a reset
+      if (!isAnimating)
+         RebuildInstances(snapshot, simulation_time);
+   }
+   const float time = static_cast<float>(simulation_time - time_epoch_);
+   if (isAnimating)
+      AnimateChangedCells(snapshot, time);
+   drawn_sequence_ = snapshot.sequence;
+
+   if (isHighlightMoved)
+   {
+      for (const auto& cell : highlights)
+      {
+         const int index = cell.x + cell.y * snapshot.world_width;
+         // Cells that changed this frame already know their size
+         if (snapshot.IsValidCell(cell.x, cell.y) && !is_pending_upload_[index])
+         {
+            instances_[index] = AnimateCell(snapshot, index, time);
+            MarkInstanceChanged(index);
+         }
+      }
+   }
+
+   // Last, the highlight check relies on only this frame's changed cells being marked
+   if (simulation_time - time_epoch_ > max_epoch_age)
+      RebaseTime(simulation_time);
+   UploadChangedInstances();
+
+   glUseProgram(game_settings_->default_shader);
+   glUniformMatrix4fv(projection_location_, 1, GL_FALSE, glm::value_ptr(camera->GetProjection()));
+   glUniform1f(time_location_, static_cast<float>(simulation_time - time_epoch_));
+
+   glBindVertexArray(vao_);
+   glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(instances_.size()));
+   glBindVertexArray(0);
+
+   return true;
+}
+
+/// <summary>
+/// Draws the board from an integer texture in a single full screen pass.
+/// Only the band of rows containing changed cells is re-uploaded.
+/// </summary>
+bool BoardRenderer::DrawTexture(const BoardSnapshot& snapshot)
+{
+   const int width = snapshot.world_width;
+   const int height = snapshot.world_height;
+   const int* worldData = snapshot.cells.data();
+
+   glActiveTexture(GL_TEXTURE0);
+   glBindTexture(GL_TEXTURE_2D, board_texture_);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+   if (board_texture_size_.x != width || board_texture_size_.y != height)
+   {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, width, height, 0, GL_RED_INTEGER, GL_INT, worldData);
+      TextureUtility::SetTexParams(GL_TEXTURE_2D, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+      board_texture_size_ = IVec2(width, height);
+   }
+   else if (drawn_sequence_ != snapshot.sequence)
+   {
+      int minRow = 0;
+      int maxRow = height - 1;
+      if (CanApplyChangedCells(snapshot))
+      {
+         minRow = height;
+         maxRow = -1;
+         for (auto index : snapshot.changed_cells)
+         {
+            const int row = index / width;
+            if (row < minRow) minRow = row;
+            if (row > maxRow) maxRow = row;
+         }
+      }
+      if (maxRow >= minRow)
+         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, minRow, width, maxRow - minRow + 1, GL_RED_INTEGER, GL_INT, worldData + (minRow * width));
+   }
+   drawn_sequence_ = snapshot.sequence;
+
+   const IVec2 screenSize = game_settings_->screen_size;
+   const Layout layout = GetLayout(screenSize, width, height);
+
+   const IVec2 movedFrom = snapshot.extra_info.last_cell_moved_from;
+   const IVec2 movedTo = snapshot.extra_info.last_cell_moved_to;
+
+   glUseProgram(game_settings_->board_shader);
+   glUniform2i(board_locations_.board_size, width, height);
+   glUniform2f(board_locations_.board_origin, layout.origin.x, layout.origin.y);
+   glUniform1f(board_locations_.cell_pitch, layout.cell_pitch);
+   glUniform1f(board_locations_.cell_size, layout.cell_size);
+   glUniform1f(board_locations_.screen_height, static_cast<float>(screenSize.y));
+   glUniform2i(board_locations_.moved_from, movedFrom.x, movedFrom.y);
+   glUniform2i(board_locations_.moved_to, movedTo.x, movedTo.y);
+
+   glBindVertexArray(empty_vao_);
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+   glBindVertexArray(0);
+
+   return true;
+}
+
+// Reallocates the instance buffer, all instances will need to be rebuilt after this.
+void BoardRenderer::ResizeInstances(const int cell_count)
+{
+   instances_.assign(cell_count, CellInstance());
+   drawn_cells_.assign(cell_count, EMPTY);
+   animated_cells_.clear();
+   animated_cells_.reserve(cell_count);
+   pending_upload_.clear();
+   pending_upload_.reserve(cell_count);
+   is_pending_upload_.assign(cell_count, false);
+
+   glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(CellInstance) * cell_count, nullptr, GL_DYNAMIC_DRAW);
+}
+
+glm::vec2 BoardRenderer::GetCellCentre(const Layout& layout, const int x, const int y) const
+{
+   return glm::vec2(layout.origin.x + (layout.cell_size / 2) + (layout.cell_pitch * x),
+                    game_settings_->screen_size.y - (layout.origin.y + (layout.cell_size / 2) + (layout.cell_pitch * y)));
+}
+
+float BoardRenderer::GetCellDrawSize(const Layout& layout, const int x, const int y) const
+{
+   const float movedScaleMultiplier = ((x == drawn_moved_from_.x && y == drawn_moved_from_.y) || (x == drawn_moved_to_.x && y == drawn_moved_to_.y)) ? 1.5f : 1.0f;
+   return layout.cell_size * movedScaleMultiplier;
+}
+
+/// <summary> Rebuilds the position, size and colour of a single cell. </summary>
+void BoardRenderer::UpdateInstance(const BoardSnapshot& snapshot, const int index)
+{
+   const int width = snapshot.world_width;
+   const int x = index % width;
+   const int y = index / width;
+   const Layout layout = GetLayout(game_settings_->screen_size, width, snapshot.world_height);
+
+   CellInstance& instance = instances_[index];
+   instance.start_position = instance.end_position = GetCellCentre(layout, x, y);
+   instance.start_size = instance.end_size = (snapshot.cells[index] == EMPTY ? 0.0f : GetCellDrawSize(layout, x, y));
+   instance.start_time = 0.0f;
+   instance.duration = 0.0f;
+   instance.easing = Linear;
+   instance.colour = GetCellColour(snapshot.cells[index]);
+   drawn_cells_[index] = snapshot.cells[index];
+
+   MarkInstanceChanged(index);
+}
+
+void BoardRenderer::RebuildInstances(const BoardSnapshot& snapshot, const double simulation_time)
+{
+   time_epoch_ = simulation_time;
+   for (int i = 0; i < static_cast<int>(instances_.size()); i++)
+      UpdateInstance(snapshot, i);
+}
+
+void BoardRenderer::RebaseTime(const double simulation_time)
+{
+   const float shift = static_cast<float>(simulation_time - time_epoch_);
+   time_epoch_ = simulation_time;
+   for (int i = 0; i < static_cast<int>(instances_.size()); i++)
+   {
+      instances_[i].start_time -= shift;
+      MarkInstanceChanged(i);
+   }
+}
+
+void BoardRenderer::AnimateChangedCells(const BoardSnapshot& snapshot, const float time)
+{
+   animated_cells_.clear();
+   for (auto index : snapshot.changed_cells)
+      animated_cells_.emplace_back(index, AnimateCell(snapshot, index, time));
+   for (const auto& [index, instance] : animated_cells_)
+   {
+      instances_[index] = instance;
+      drawn_cells_[index] = snapshot.cells[index];
+      MarkInstanceChanged(index);
+   }
+}
+
+/// <summary>
+/// Works out a changed cell's animation from what it was drawn as and what it is now. The board only moves a cell one row per step,
+/// so a cell that was empty has fallen from the row above, or been refilled above the top row, and falls for one step's time.
+/// A fall that carries on starts where the previous one is now, so a column falls smoothly rather than a row at a time.
+/// Swapped cells move between each other's places, and cleared cells shrink away.
+/// </summary>
+BoardRenderer::CellInstance BoardRenderer::AnimateCell(const BoardSnapshot& snapshot, const int index, const float time) const
+{
+   const int width = snapshot.world_width;
+   const int x = index % width;
+   const int y = index / width;
+   const Layout layout = GetLayout(game_settings_->screen_size, width, snapshot.world_height);
+   const int previous = drawn_cells_[index];
+   const int current = snapshot.cells[index];
+
+   CellInstance instance;
+   EvaluateInstance(instances_[index], time, instance.start_position, instance.start_size);
+   instance.end_position = GetCellCentre(layout, x, y);
+   instance.end_size = GetCellDrawSize(layout, x, y);
+   instance.start_time = time;
+   instance.duration = snapshot.step_time;
+   instance.easing = EaseOut;
+   instance.colour = GetCellColour(current);
+
+   if (current == EMPTY)
+   {
+      const int below = index + width;
+      const bool hasFallen = (y + 1 < snapshot.world_height && drawn_cells_[below] == EMPTY && snapshot.cells[below] == previous);
+      // A fallen cell is drawn by the cell below now, a cleared one shrinks away in its old colour
+      instance.end_position = instance.start_position;
+      instance.end_size = 0.0f;
+      if (hasFallen || previous == EMPTY)
+         instance.start_size = 0.0f;
+      else
+         instance.colour = GetCellColour(previous);
+   }
+   else if (previous == EMPTY)
+   {
+      const int above = index - width;
+      glm::vec2 abovePosition;
+      float aboveSize;
+      if (y > 0 && drawn_cells_[above] == current && snapshot.cells[above] != current)
+         EvaluateInstance(instances_[above], time, abovePosition, aboveSize);
+      else
+         abovePosition = instance.end_position + glm::vec2(0.0f, layout.cell_pitch);
+      instance.start_position = abovePosition;
+      instance.start_size = layout.cell_size;
+      instance.easing = Linear;
+   }
+   else
+   {
+      // Swapped cells hold what the other one had, they start from where the other is drawn
+      const IVec2 movedFrom = snapshot.extra_info.last_cell_moved_from;
+      const IVec2 movedTo = snapshot.extra_info.last_cell_moved_to;
+      const IVec2 cell(x, y);
+      const IVec2 other = (cell == movedFrom ? movedTo : (cell == movedTo ? movedFrom : IVec2(-1, -1)));
+      float otherSize;
+      if (previous != current && snapshot.IsValidCell(other.x, other.y) && drawn_cells_[other.x + other.y * width] == current)
+         EvaluateInstance(instances_[other.x + other.y * width], time, instance.start_position, otherSize);
+   }
+   return instance;
+}
+
+void BoardRenderer::EvaluateInstance(const CellInstance& instance, const float time, glm::vec2& position, float& size)
+{
+   float t = (instance.duration > 0.0f ? std::clamp((time - instance.start_time) / instance.duration, 0.0f, 1.0f) : 1.0f);
+   if (instance.easing == EaseOut)
+      t = 1.0f - (1.0f - t) * (1.0f - t) * (1.0f - t);
+   position = glm::mix(instance.start_position, instance.end_position, t);
+   size = glm::mix(instance.start_size, instance.end_size, t);
+}
+
+void BoardRenderer::MarkInstanceChanged(const int index)
+{
+   if (is_pending_upload_[index])
+      return;
+   is_pending_upload_[index] = true;
+   pending_upload_.push_back(index);
+}
+
+/// <summary>
+/// Uploads all instances marked as changed, runs of neighbouring instances are sent as a single glBufferSubData.
+/// </summary>
+void BoardRenderer::UploadChangedInstances()
+{
+   if (pending_upload_.empty())
+      return;
+
+   glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+   // Most of the board changed, cheaper to send it all at once
+   if (pending_upload_.size() > instances_.size() / 2)
+   {
+      glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(CellInstance) * instances_.size(), instances_.data());
+   }
+   else
+   {
+      std::sort(pending_upload_.begin(), pending_upload_.end());
+      size_t runStart = 0;
+      for (size_t i = 1; i <= pending_upload_.size(); i++)
+      {
+         if (i < pending_upload_.size() && pending_upload_[i] == pending_upload_[i - 1] + 1)
+            continue;
+
+         const int first = pending_upload_[runStart];
+         const int count = pending_upload_[i - 1] - first + 1;
+         glBufferSubData(GL_ARRAY_BUFFER, sizeof(CellInstance) * first, sizeof(CellInstance) * count, &instances_[first]);
+         runStart = i;
+      }
+   }
+
+   for (auto index : pending_upload_)
+      is_pending_upload_[index] = false;
+   pending_upload_.clear();
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Camera.h"
+#include "GameSettings.h"
+#include "IVec2.h"
+#include "BoardSnapshot.h"
+
+/// <summary>
+/// Draws a published BoardSnapshot using the BoardRenderMode from GameSettings.
+/// Instanced: a single instanced draw call, per-cell instance data is only rebuilt and re-uploaded for cells the snapshot reports as changed.
+/// Each instance holds an animation (swap, fall or clear) that starts when its cell changes, the vertex shader plays it against the
+/// time uniform so cells in motion cost nothing on the CPU after that first upload.
+/// Texture: the board is kept in an integer texture and drawn with one full screen pass, CPU cost does not depend on board size.
+/// </summary>
+class BoardRenderer
+{
+public:
+   BoardRenderer(GameSettings* settings);
+   ~BoardRenderer();
+
+   // simulation_time is milliseconds since the simulation started, cell animations are timed against it
+   bool Draw(Camera* camera, const BoardSnapshot& snapshot, double simulation_time);
+
+   // Converts a CellType into the colour it is drawn with
+   static glm::vec4 GetCellColour(int cell_type);
+
+   // Where a board's cells go on screen, in pixels from the top left
+   struct Layout
+   {
+      glm::vec2 origin;
+      float cell_pitch;
+      float cell_size;
+   };
+   // Cells are drawn at cell_screen_size, shrunk down if the board would not otherwise fit on screen
+   static Layout GetLayout(IVec2 screen_size, int width, int height);
+
+private:
+   // Matches Ease in orthoWorld.vert
+   enum Easing : GLint
+   {
+      Linear = 0,
+      EaseOut = 1
+   };
+
+   // Matches the per-instance attributes in orthoWorld.vert. Positions are cell centres in pixels from the bottom left.
+   struct CellInstance
+   {
+      glm::vec2 start_position;
+      glm::vec2 end_position;
+      // Milliseconds since time_epoch_
+      float start_time;
+      // 0 jumps straight to the end
+      float duration;
+      float start_size;
+      float end_size;
+      glm::vec4 colour;
+      GLint easing;
+   };
+
+   GameSettings* game_settings_;
+
+   // Look up uniforms once the program is ready, false while it is still compiling
+   bool SetupWorldShader();
+   bool SetupBoardShader();
+   bool is_world_shader_setup_ = false;
+   bool is_board_shader_setup_ = false;
+
+   bool DrawInstanced(Camera* camera, const BoardSnapshot& snapshot, double simulation_time);
+   bool DrawTexture(const BoardSnapshot& snapshot);
+   // Returns true if only the snapshot's changed cells need updating, false if everything does
+   bool CanApplyChangedCells(const BoardSnapshot& snapshot) const;
+
+   void ResizeInstances(int cell_count);
+   // Places a cell without animating it
+   void UpdateInstance(const BoardSnapshot& snapshot, int index);
+   // Places every cell without animating them, nothing is timed from the old epoch any more so it moves up to simulation_time
+   void RebuildInstances(const BoardSnapshot& snapshot, double simulation_time);
+   // Moves the epoch up to simulation_time, shifting every instance's start time to match and uploading them all again
+   void RebaseTime(double simulation_time);
+   // Starts the animations of every changed cell, from wherever their cells are drawn at time
+   void AnimateChangedCells(const BoardSnapshot& snapshot, float time);
+   CellInstance AnimateCell(const BoardSnapshot& snapshot, int index, float time) const;
+   // Where an instance is drawn at time, the same sum as orthoWorld.vert
+   static void EvaluateInstance(const CellInstance& instance, float time, glm::vec2& position, float& size);
+   glm::vec2 GetCellCentre(const Layout& layout, int x, int y) const;
+   float GetCellDrawSize(const Layout& layout, int x, int y) const;
+   void UploadChangedInstances();
+   void MarkInstanceChanged(int index);
+
+   std::vector<CellInstance> instances_;
+   // Cell types the instances were last built from, a changed cell's animation depends on what it was before
+   std::vector<int> drawn_cells_;
+   // New instances are all worked out before any are written, a falling cell starts from where the cell above it is drawn
+   std::vector<std::pair<int, CellInstance>> animated_cells_;
+   // Instance indexes waiting to be uploaded, sorted before upload so neighbours can be sent together
+   std::vector<int> pending_upload_;
+   std::vector<bool> is_pending_upload_;
+
+   // Snapshot the current instance/texture data represents
+   Uint32 drawn_sequence_ = 0;
+   IVec2 drawn_moved_from_ = IVec2(-1, -1);
+   IVec2 drawn_moved_to_ = IVec2(-1, -1);
+
+   GLint projection_location_ = -1;
+   GLint time_location_ = -1;
+   // Animation times are floats in milliseconds since this simulation time, far enough from it they would lose precision
+   double time_epoch_ = 0.0;
+   // About 17 minutes, times stay accurate to an eighth of a millisecond
+   static constexpr double max_epoch_age = 1 << 20;
+
+   unsigned int vbo_;
+   unsigned int vao_;
+   unsigned int ebo_;
+   unsigned int instance_vbo_;
+
+   // Texture mode
+   IVec2 board_texture_size_ = IVec2(0, 0);
+   GLuint board_texture_ = 0;
+   // Full screen triangle is generated in the shader, but a VAO still needs to be bound
+   unsigned int empty_vao_;
+
+   struct BoardShaderLocations
+   {
+      GLint board_size = -1;
+      GLint board_origin = -1;
+      GLint cell_pitch = -1;
+      GLint cell_size = -1;
+      GLint screen_height = -1;
+      GLint moved_from = -1;
+      GLint moved_to = -1;
+   } board_locations_;
+};
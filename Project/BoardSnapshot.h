@@ -0,0 +1,125 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "ExtraInfoGUI.h"
+#include "Match3.h"
+
+/// <summary>
+/// Copy of everything needed to draw a board, published by the simulation for the renderer.
+/// Once published a snapshot is never modified, so the renderer can read it without locking.
+/// </summary>
+struct BoardSnapshot
+{
+   // Incremented on every publish
+   Uint32 sequence = 0;
+   Uint32 board_version = 0;
+
+   int world_width = 0;
+   int world_height = 0;
+   std::vector<int> cells;
+   // Cells changed since snapshot (sequence - 1), the renderer has to upload everything if it skipped a snapshot
+   std::vector<int> changed_cells;
+
+   ExtraInfoGUI extra_info;
+   // Milliseconds between the board's steps, the renderer times its animations with it
+   float step_time = 0.0f;
+
+   // Monitor view, one per board with where its top left cell is in cells and what to overlay on it. Empty for a single board.
+   struct BoardTile
+   {
+      int x;
+      int y;
+      int score;
+      int moves;
+   };
+   std::vector<BoardTile> tiles;
+
+   // Fixed step timing when the snapshot was published, lets the renderer work out its interpolation
+   double published_time = 0.0;
+   double fixed_alpha = 0.0;
+   Uint32 fixed_step_cap_hits = 0;
+   // Simulation clock time since the simulation started
+   double simulation_time = 0.0;
+   // Fixed steps run since the last snapshot, and the heap allocations they made
+   int fixed_steps = 0;
+   uint64_t fixed_step_allocations = 0;
+
+   /// <summary> Copies the board into this snapshot, cells are only copied if this snapshot holds an older board version. </summary>
+   void Capture(const Match3& match3, const Uint32 new_sequence)
+   {
+      const GameRules* rules = match3.GetRules();
+      if (board_version != match3.GetBoardVersion() || world_width != rules->world_width || world_height != rules->world_height)
+      {
+         cells.assign(match3.GetWorldData(), match3.GetWorldData() + rules->world_size_total);
+         // Every cell can change at once, sized up front so publishing never has to grow it
+         changed_cells.reserve(rules->world_size_total);
+         board_version = match3.GetBoardVersion();
+         world_width = rules->world_width;
+         world_height = rules->world_height;
+      }
+      changed_cells.assign(match3.GetChangedCells().begin(), match3.GetChangedCells().end());
+      extra_info = match3.g_extraInfo;
+      step_time = match3.GetUpdateRate();
+      tiles.clear();
+      sequence = new_sequence;
+   }
+
+   /// <summary>
+   /// Copies boards into one grid of cells, columns boards wide with an empty cell between neighbours, so the renderer draws them
+   /// all like a single board. All boards have to be the same size. boards[0] sits in the top left, so its moved cells and
+   /// extra info still line up. Cells are only copied if one of the boards has changed.
+   /// </summary>
+   void CaptureGrid(const Match3* const* boards, const int board_count, const int columns, const Uint32 new_sequence)
+   {
+      const GameRules* rules = boards[0]->GetRules();
+      const int tileWidth = rules->world_width + 1;
+      const int tileHeight = rules->world_height + 1;
+      const int rows = (board_count + columns - 1) / columns;
+      const int gridWidth = columns * tileWidth - 1;
+      const int gridHeight = rows * tileHeight - 1;
+
+      // Every board's version only ever goes up, so the sum changes whenever any of them do
+      Uint32 gridVersion = 0;
+      for (int i = 0; i < board_count; i++)
+         gridVersion += boards[i]->GetBoardVersion();
+
+      const bool isResized = (world_width != gridWidth || world_height != gridHeight);
+      if (isResized)
+      {
+         cells.assign(static_cast<size_t>(gridWidth) * gridHeight, EMPTY);
+         changed_cells.reserve(cells.size());
+         tiles.reserve(board_count);
+         world_width = gridWidth;
+         world_height = gridHeight;
+      }
+      tiles.clear();
+      changed_cells.clear();
+      for (int i = 0; i < board_count; i++)
+      {
+         const Match3& board = *boards[i];
+         const int tileX = (i % columns) * tileWidth;
+         const int tileY = (i / columns) * tileHeight;
+         const int origin = tileX + tileY * gridWidth;
+         tiles.push_back({ tileX, tileY, board.g_extraInfo.game_score, board.g_extraInfo.moves_since_last_reset });
+
+         if (isResized || board_version != gridVersion)
+         {
+            const int* worldData = board.GetWorldData();
+            for (int y = 0; y < rules->world_height; y++)
+               std::copy(worldData + y * rules->world_width, worldData + (y + 1) * rules->world_width, cells.begin() + origin + y * gridWidth);
+         }
+         for (const int index : board.GetChangedCells())
+            changed_cells.push_back(origin + (index % rules->world_width) + (index / rules->world_width) * gridWidth);
+      }
+      board_version = gridVersion;
+      extra_info = boards[0]->g_extraInfo;
+      step_time = boards[0]->GetUpdateRate();
+      sequence = new_sequence;
+   }
+
+   bool IsValidCell(const int x, const int y) const
+   {
+      return (x >= 0 && x < world_width && y >= 0 && y < world_height);
+   }
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+/// <summary>
+/// Source of time in milliseconds for the game loop and simulation.
+/// </summary>
+class Clock
+{
+public:
+   virtual ~Clock() = default;
+   virtual double Now() const = 0;
+};
+
+/// <summary>
+/// Wall clock time.
+/// </summary>
+class RealClock final : public Clock
+{
+public:
+   double Now() const override
+   {
+      typedef std::chrono::duration<double, std::milli> duration;
+      return static_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+};
+
+/// <summary>
+/// Time that only moves when told to, so the simulation can run faster than real time and be stepped deterministically.
+/// Advanced by the simulation, can be read from any thread.
+/// </summary>
+class VirtualClock final : public Clock
+{
+public:
+   double Now() const override { return now_.load(std::memory_order_acquire); }
+
+   void Advance(const double milliseconds)
+   {
+      now_.store(now_.load(std::memory_order_relaxed) + milliseconds, std::memory_order_release);
+   }
+
+private:
+   std::atomic<double> now_{ 0.0 };
+};
@@ -0,0 +1,53 @@
+#include "CommandQueue.h"
+
+CommandQueue::CommandQueue()
+{
+   for (uint64_t i = 0; i < capacity; i++)
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool CommandQueue::Push(const Command& command)
+{
+   uint64_t position = push_position_.load(std::memory_order_relaxed);
+   Slot* slot;
+   while (true)
+   {
+      slot = &slots_[position & (capacity - 1)];
+      const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+      if (difference == 0)
+      {
+         // Free, claim it. On failure position is reloaded and we try the next slot
+         if (push_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            break;
+      }
+      else if (difference < 0)
+      {
+         // Still holds a command from a lap ago, the consumer hasn't caught up
+         dropped_.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      }
+      else
+      {
+         // Another producer claimed it first
+         position = push_position_.load(std::memory_order_relaxed);
+      }
+   }
+
+   slot->command = command;
+   slot->sequence.store(position + 1, std::memory_order_release);
+   return true;
+}
+
+bool CommandQueue::Pop(Command& out)
+{
+   Slot& slot = slots_[pop_position_ & (capacity - 1)];
+   if (slot.sequence.load(std::memory_order_acquire) != pop_position_ + 1)
+      return false;
+
+   out = slot.command;
+   // Free for the producer that pushes to this slot on the next lap
+   slot.sequence.store(pop_position_ + capacity, std::memory_order_release);
+   pop_position_++;
+   return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <SDL_stdinc.h>
+
+#include "IVec2.h"
+
+/// <summary>
+/// A request to change the simulation. Controllers (input, the AI, anything else) never touch Match3 directly,
+/// they submit commands and the simulation applies them at the start of its next fixed step.
+/// </summary>
+struct Command
+{
+   enum Type : Uint8
+   {
+      // Match3::Step from -> to
+      Swap,
+      // Clears the board, it refills over the next steps like when no moves are left
+      Reset,
+      // Sets the world update rate to value (ms between steps)
+      SetUpdateRate,
+      // Switches the world update rate between 50ms and 250ms
+      ToggleUpdateRate,
+      PrintBoard,
+      ToggleAiLog
+   };
+
+   Type type;
+   IVec2 from;
+   IVec2 to;
+   float value;
+   // SDL timestamp of the input that asked for this, 0 if it didn't come from input
+   Uint32 input_time;
+
+   static Command Make(const Type type, const Uint32 input_time = 0)
+   {
+      return Command{ type, IVec2(-1, -1), IVec2(-1, -1), 0.0f, input_time };
+   }
+
+   static Command MakeSwap(const IVec2 from, const IVec2 to, const Uint32 input_time = 0)
+   {
+      return Command{ Swap, from, to, 0.0f, input_time };
+   }
+};
+
+/// <summary>
+/// Bounded lock-free multi producer, single consumer queue of commands.
+/// Any thread can Push, only the simulation Pops. Each slot carries a sequence number saying whether it is free for the
+/// producer that claimed it or holds a command for the consumer, so neither side ever takes a lock or waits on the other.
+/// A full queue rejects the command rather than blocking.
+/// </summary>
+class CommandQueue
+{
+public:
+   // Power of two, far more than the simulation ever has queued up between fixed steps
+   static constexpr uint64_t capacity = 256;
+
+   CommandQueue();
+   CommandQueue(const CommandQueue&) = delete;
+   CommandQueue& operator=(const CommandQueue&) = delete;
+
+   // Thread safe, returns false if the queue is full
+   bool Push(const Command& command);
+   // Consumer thread only, returns false once the queue is empty
+   bool Pop(Command& out);
+
+   // Commands rejected because the queue was full
+   uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+   static_assert((capacity & (capacity - 1)) == 0, "CommandQueue capacity has to be a power of two");
+
+   struct Slot
+   {
+      // Equal to the push position when the slot is free, position + 1 once it holds that position's command
+      std::atomic<uint64_t> sequence;
+      Command command;
+   };
+
+   Slot slots_[capacity];
+   // Producers and the consumer on separate cache lines, so pushing doesn't keep stealing the consumer's line
+   alignas(64) std::atomic<uint64_t> push_position_{ 0 };
+   alignas(64) uint64_t pop_position_ = 0;
+   std::atomic<uint64_t> dropped_{ 0 };
+};
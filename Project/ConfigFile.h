@@ -13,6 +13,39 @@ struct ConfigFile final : public ISerializable
    int world_size_x = 8;
    int world_size_y = 8;
 
+   // 0 = Instanced cells, 1 = Board texture drawn in a single full screen pass
+   int board_render_mode = 0;
+
+   // 0 picks a new seed every run
+   unsigned int random_seed = 0;
+
+   // Runs the simulation on its own thread, separate from rendering
+   bool threaded_simulation = true;
+
+   // 0 = VSync, 1 = Adaptive VSync (falls back to VSync), 2 = Uncapped, 3 = Capped to target_frames_per_second with VSync off
+   int frame_pacing_mode = 0;
+
+   // Runs the simulation as fast as it can on virtual time, the renderer only shows the latest state
+   bool turbo_simulation = false;
+
+   // Seconds between writing engine counters to data/engine_counters.json and .csv, 0 only writes on exit
+   float counters_export_interval = 10.0f;
+
+   // Records every session to data/replays, play one back with --replay=path
+   bool record_replay = false;
+   // Moves between replay keyframes, lower seeks faster but makes bigger files
+   int replay_keyframe_interval = 32;
+
+   // Moves the AI looks ahead, 0 plays the first legal move it finds
+   int ai_search_depth = 0;
+   // Megabytes the AI's search may use, searches that would need more are cut short
+   int ai_memory_cap_mb = 16;
+   // Searches for the next move on its own thread while the board is still settling from the last one
+   bool ai_background_search = true;
+
+   // Boards shown at once in a grid, each played by the AI. 0 or 1 shows the single board as usual
+   int monitor_boards = 0;
+
    SaveTypes SaveType() override
    {
       return SaveTypes::Json;
@@ -30,17 +63,59 @@ struct ConfigFile final : public ISerializable
       out_archive(CEREAL_NVP(cell_types_used));
       out_archive(CEREAL_NVP(world_size_x));
       out_archive(CEREAL_NVP(world_size_y));
+      out_archive(CEREAL_NVP(board_render_mode));
+      out_archive(CEREAL_NVP(random_seed));
+      out_archive(CEREAL_NVP(threaded_simulation));
+      out_archive(CEREAL_NVP(frame_pacing_mode));
+      out_archive(CEREAL_NVP(turbo_simulation));
+      out_archive(CEREAL_NVP(counters_export_interval));
+      out_archive(CEREAL_NVP(record_replay));
+      out_archive(CEREAL_NVP(replay_keyframe_interval));
+      out_archive(CEREAL_NVP(ai_search_depth));
+      out_archive(CEREAL_NVP(ai_memory_cap_mb));
+      out_archive(CEREAL_NVP(ai_background_search));
+      out_archive(CEREAL_NVP(monitor_boards));
 
    }
 
+   // Loaded by name rather than in order, so a config written before a key was added still loads and that key keeps its default
    virtual void Load(cereal::JSONInputArchive in_archive) override
    {
-      in_archive(screen_x);
-      in_archive(screen_y);
-      in_archive(target_frames_per_second);
-      in_archive(target_fixed_updates_per_second);
-      in_archive(cell_types_used);
-      in_archive(world_size_x);
-      in_archive(world_size_y);
+      LoadValue(in_archive, "screen_x", screen_x);
+      LoadValue(in_archive, "screen_y", screen_y);
+      LoadValue(in_archive, "target_frames_per_second", target_frames_per_second);
+      LoadValue(in_archive, "target_fixed_updates_per_second", target_fixed_updates_per_second);
+      LoadValue(in_archive, "cell_types_used", cell_types_used);
+      LoadValue(in_archive, "world_size_x", world_size_x);
+      LoadValue(in_archive, "world_size_y", world_size_y);
+      LoadValue(in_archive, "board_render_mode", board_render_mode);
+      LoadValue(in_archive, "random_seed", random_seed);
+      LoadValue(in_archive, "threaded_simulation", threaded_simulation);
+      LoadValue(in_archive, "frame_pacing_mode", frame_pacing_mode);
+      LoadValue(in_archive, "turbo_simulation", turbo_simulation);
+      LoadValue(in_archive, "counters_export_interval", counters_export_interval);
+      LoadValue(in_archive, "record_replay", record_replay);
+      LoadValue(in_archive, "replay_keyframe_interval", replay_keyframe_interval);
+      LoadValue(in_archive, "ai_search_depth", ai_search_depth);
+      LoadValue(in_archive, "ai_memory_cap_mb", ai_memory_cap_mb);
+      LoadValue(in_archive, "ai_background_search", ai_background_search);
+      LoadValue(in_archive, "monitor_boards", monitor_boards);
+   }
+
+   // Set by Load if the file was missing any keys, saving again adds them with their defaults
+   bool has_missing_keys = false;
+
+private:
+   template <typename T>
+   void LoadValue(cereal::JSONInputArchive& archive, const char* name, T& value)
+   {
+      try
+      {
+         archive(cereal::make_nvp(name, value));
+      }
+      catch (const cereal::Exception&)
+      {
+         has_missing_keys = true;
+      }
    }
 };
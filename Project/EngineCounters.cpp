@@ -0,0 +1,116 @@
+#include "EngineCounters.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+   const char* counter_names[EngineCounters::counter_count] = {
+      "cells_scanned",
+      "match_checks",
+      "matches_found",
+      "cells_cleared",
+      "gravity_steps",
+      "cells_fallen",
+      "refill_cells",
+      "legal_move_searches",
+      "legal_move_search_ns",
+      "ai_nodes",
+      "moves",
+      "rejected_moves",
+      "cascade_rounds",
+      "max_cascade_depth"
+   };
+}
+
+EngineCounters* EngineCounters::Instance()
+{
+   // Counted from the simulation thread as well, so created thread safe like Profiler
+   static EngineCounters* instance = new EngineCounters();
+   return instance;
+}
+
+const char* EngineCounters::GetName(const EngineCounter counter)
+{
+   return counter_names[static_cast<int>(counter)];
+}
+
+EngineCounters::Shard* EngineCounters::GetShard()
+{
+   thread_local Shard* shard = nullptr;
+   if (!shard)
+      shard = Instance()->CreateShard();
+   return shard;
+}
+
+EngineCounters::Shard* EngineCounters::CreateShard()
+{
+   std::lock_guard<std::mutex> lock(shards_mutex_);
+   shards_.push_back(std::make_unique<Shard>());
+   return shards_.back().get();
+}
+
+uint64_t EngineCounters::Total(const EngineCounter counter) const
+{
+   const int index = static_cast<int>(counter);
+   uint64_t total = 0;
+   std::lock_guard<std::mutex> lock(shards_mutex_);
+   for (const auto& shard : shards_)
+   {
+      const uint64_t value = shard->values[index].load(std::memory_order_relaxed);
+      if (counter == EngineCounter::MaxCascadeDepth)
+         total = (value > total ? value : total);
+      else
+         total += value;
+   }
+   return total;
+}
+
+void EngineCounters::UpdateRates(const double now_milliseconds)
+{
+   if (start_time_ < 0.0)
+   {
+      start_time_ = now_milliseconds;
+      rate_time_ = now_milliseconds;
+   }
+
+   const double elapsed = now_milliseconds - rate_time_;
+   if (elapsed < 1000.0)
+      return;
+
+   for (int i = 0; i < counter_count; i++)
+   {
+      const uint64_t total = Total(static_cast<EngineCounter>(i));
+      rates_[i] = static_cast<double>(total - rate_totals_[i]) * 1000.0 / elapsed;
+      rate_totals_[i] = total;
+   }
+   rate_time_ = now_milliseconds;
+}
+
+bool EngineCounters::AppendCsv(const std::string& path, const double now_milliseconds) const
+{
+   std::ifstream existing(path);
+   const bool needsHeader = !existing.good() || existing.peek() == std::ifstream::traits_type::eof();
+   existing.close();
+
+   std::ofstream csv(path, std::ios::app);
+   if (!csv.good())
+   {
+      printf("Failed to open counters file %s\n", path.c_str());
+      return false;
+   }
+
+   if (needsHeader)
+   {
+      csv << "elapsed_seconds";
+      for (const char* name : counter_names)
+         csv << ',' << name;
+      csv << '\n';
+   }
+
+   csv << GetElapsedSeconds(now_milliseconds);
+   for (int i = 0; i < counter_count; i++)
+      csv << ',' << Total(static_cast<EngineCounter>(i));
+   csv << '\n';
+   return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class EngineCounter
+{
+   // Cells visited by any of the board kernels
+   CellsScanned,
+   // CheckMatches calls
+   MatchChecks,
+   MatchesFound,
+   CellsCleared,
+   // StepCellsDown passes that moved something, and the cells they moved
+   GravitySteps,
+   CellsFallen,
+   RefillCells,
+   LegalMoveSearches,
+   LegalMoveSearchNanoseconds,
+   // Moves the AI looked at picking one, lookahead nodes or the legal move search's candidate swaps without lookahead
+   AiNodes,
+   Moves,
+   RejectedMoves,
+   // Clear rounds caused by moves, divide by Moves for the average cascade depth
+   CascadeRounds,
+   // Tracked as a maximum rather than a total
+   MaxCascadeDepth,
+   Count
+};
+
+/// <summary>
+/// Engine performance counters, cheap enough to bump from inside the board kernels.
+/// Each thread writes to its own cache line sized shard without any atomic read-modify-write, readers add the shards together.
+/// </summary>
+class EngineCounters
+{
+public:
+   static constexpr int counter_count = static_cast<int>(EngineCounter::Count);
+
+   static EngineCounters* Instance();
+   static const char* GetName(EngineCounter counter);
+
+   static void Add(const EngineCounter counter, const uint64_t amount = 1)
+   {
+      std::atomic<uint64_t>& value = GetShard()->values[static_cast<int>(counter)];
+      // Only this thread ever writes the shard, so a plain load and store is enough
+      value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+   }
+
+   static void Max(const EngineCounter counter, const uint64_t amount)
+   {
+      std::atomic<uint64_t>& value = GetShard()->values[static_cast<int>(counter)];
+      if (amount > value.load(std::memory_order_relaxed))
+         value.store(amount, std::memory_order_relaxed);
+   }
+
+   // Sum across every thread (or the largest, for maximum counters)
+   uint64_t Total(EngineCounter counter) const;
+
+   // Works out per second rates, at most once a second. Call from a single thread.
+   void UpdateRates(double now_milliseconds);
+   double GetRate(const EngineCounter counter) const { return rates_[static_cast<int>(counter)]; }
+   double GetElapsedSeconds(double now_milliseconds) const { return (now_milliseconds - start_time_) / 1000.0; }
+
+   /// <summary> Appends a row of totals to a CSV file, writing the header first if the file is new. </summary>
+   bool AppendCsv(const std::string& path, double now_milliseconds) const;
+
+private:
+   struct alignas(64) Shard
+   {
+      std::atomic<uint64_t> values[counter_count]{};
+   };
+
+   EngineCounters() = default;
+
+   static Shard* GetShard();
+   Shard* CreateShard();
+
+   mutable std::mutex shards_mutex_;
+   std::vector<std::unique_ptr<Shard>> shards_;
+
+   double start_time_ = -1.0;
+   double rate_time_ = 0.0;
+   uint64_t rate_totals_[counter_count]{};
+   double rates_[counter_count]{};
+};
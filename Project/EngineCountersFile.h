@@ -0,0 +1,36 @@
+#pragma once
+#include "ISerializable.h"
+#include "EngineCounters.h"
+
+/// <summary>
+/// Engine counter totals and rates at the time of saving, written out periodically for tuning.
+/// Only ever saved, counters always start from zero.
+/// </summary>
+struct EngineCountersFile final : public ISerializable
+{
+   double elapsed_seconds = 0.0;
+
+   SaveTypes SaveType() override
+   {
+      return SaveTypes::Json;
+   }
+
+   std::string FilePath() override { return std::string("engine_counters"); }
+
+   // Inherited via ISerializable
+   virtual void Save(cereal::JSONOutputArchive out_archive) override
+   {
+      EngineCounters* counters = EngineCounters::Instance();
+      out_archive(CEREAL_NVP(elapsed_seconds));
+      for (int i = 0; i < EngineCounters::counter_count; i++)
+      {
+         const auto counter = static_cast<EngineCounter>(i);
+         out_archive(cereal::make_nvp(EngineCounters::GetName(counter), counters->Total(counter)));
+      }
+      for (int i = 0; i < EngineCounters::counter_count; i++)
+      {
+         const auto counter = static_cast<EngineCounter>(i);
+         out_archive(cereal::make_nvp(std::string(EngineCounters::GetName(counter)) + "_per_second", counters->GetRate(counter)));
+      }
+   }
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+
 #include "IVec2.h"
 
 // Simple class that just acts as a container for information we want to show in ImGUI.
@@ -17,6 +19,17 @@ public:
    bool next_frame_restarts = false;
    float world_step_cooldown = 0.0f;
 
+   // Simulation timing, filled in by the renderer from the latest snapshot
+   float fixed_step_time = 0.0f;
+   float fixed_interpolation = 0.0f;
+   Uint32 fixed_step_cap_hits = 0;
+   // Simulated time against real time since the simulation started
+   float simulation_seconds = 0.0f;
+   float simulation_speed = 0.0f;
+   // Heap allocations in the last frame, and per fixed step, zero once everything has warmed up
+   uint64_t frame_allocations = 0;
+   float fixed_step_allocations = 0.0f;
+
    void AddPoint()
    {
       game_score++;
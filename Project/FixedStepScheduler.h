@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+
+/// <summary>
+/// Turns variable frame deltas into a whole number of fixed steps, so the simulation runs at the same rate regardless of display refresh.
+/// If more than max_steps are owed in one go the extra time is dropped rather than carried over (spiral of death), and the hit is counted.
+/// </summary>
+class FixedStepScheduler
+{
+public:
+   FixedStepScheduler() = default;
+   FixedStepScheduler(const double step_time, const int max_steps)
+   {
+      step_time_ = step_time;
+      max_steps_ = max_steps;
+   }
+
+   // Adds delta (ms) and returns how many fixed steps should be run for it
+   int Advance(const double delta_time)
+   {
+      accumulator_ += delta_time;
+      int steps = 0;
+      while (accumulator_ >= step_time_)
+      {
+         accumulator_ -= step_time_;
+         steps++;
+         if (steps >= max_steps_)
+         {
+            // Keep the partial step, anything beyond that we are never going to catch up on
+            while (accumulator_ >= step_time_)
+               accumulator_ -= step_time_;
+            cap_hits_++;
+            // Only report when we start falling behind, not every frame we stay behind
+            if (!was_capped_)
+               printf("Fixed update fell behind, capped at %i steps (%u times)\n", max_steps_, cap_hits_);
+            was_capped_ = true;
+            total_steps_ += steps;
+            return steps;
+         }
+      }
+      was_capped_ = false;
+      total_steps_ += steps;
+      return steps;
+   }
+
+   // How far we are between the last fixed step and the next (0-1)
+   double Alpha() const { return accumulator_ / step_time_; }
+   // Time (ms) until the next fixed step is due
+   double TimeUntilNextStep() const { return step_time_ - accumulator_; }
+
+   double StepTime() const { return step_time_; }
+   uint32_t CapHits() const { return cap_hits_; }
+   uint64_t TotalSteps() const { return total_steps_; }
+
+private:
+   double step_time_ = 1000.0 / 60.0;
+   int max_steps_ = 10;
+
+   double accumulator_ = 0.0;
+   bool was_capped_ = false;
+   uint32_t cap_hits_ = 0;
+   uint64_t total_steps_ = 0;
+};
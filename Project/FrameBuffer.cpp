@@ -0,0 +1,120 @@
+#include "FrameBuffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+FrameBuffer::~FrameBuffer()
+{
+   if (fbo_ != 0)
+   {
+      glDeleteRenderbuffers(1, &depth_);
+      glDeleteRenderbuffers(1, &colour_);
+      glDeleteFramebuffers(1, &fbo_);
+   }
+}
+
+bool FrameBuffer::Create(const int width, const int height)
+{
+   width_ = width;
+   height_ = height;
+
+   glGenFramebuffers(1, &fbo_);
+   glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+
+   glGenRenderbuffers(1, &colour_);
+   glBindRenderbuffer(GL_RENDERBUFFER, colour_);
+   glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour_);
+
+   glGenRenderbuffers(1, &depth_);
+   glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_);
+
+   const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   if (status != GL_FRAMEBUFFER_COMPLETE)
+   {
+      printf("Framebuffer incomplete! Status: 0x%x\n", status);
+      return false;
+   }
+   return true;
+}
+
+void FrameBuffer::Bind() const
+{
+   glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+}
+
+void FrameBuffer::Unbind()
+{
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameBuffer::ReadPixels(std::vector<unsigned char>& pixels) const
+{
+   const int rowSize = width_ * 3;
+   std::vector<unsigned char> flipped(rowSize * height_);
+
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+   glPixelStorei(GL_PACK_ALIGNMENT, 1);
+   glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, flipped.data());
+
+   // GL reads bottom row first, images are stored top row first
+   pixels.resize(flipped.size());
+   for (int y = 0; y < height_; y++)
+      std::copy_n(&flipped[(height_ - 1 - y) * rowSize], rowSize, &pixels[y * rowSize]);
+}
+
+bool FrameBuffer::SaveToFile(const std::string& path) const
+{
+   std::vector<unsigned char> pixels;
+   ReadPixels(pixels);
+
+   std::ofstream file(path, std::ios::binary);
+   if (!file)
+   {
+      printf("Unable to write image: %s\n", path.c_str());
+      return false;
+   }
+   file << "P6\n" << width_ << " " << height_ << "\n255\n";
+   file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+   return true;
+}
+
+int FrameBuffer::CompareToFile(const std::string& path, const int tolerance) const
+{
+   std::ifstream file(path, std::ios::binary);
+   if (!file)
+   {
+      printf("Unable to read image: %s\n", path.c_str());
+      return -1;
+   }
+   std::string magic;
+   int width = 0, height = 0, maxValue = 0;
+   file >> magic >> width >> height >> maxValue;
+   file.get();
+   if (magic != "P6" || width != width_ || height != height_ || maxValue != 255)
+   {
+      printf("Image %s does not match the framebuffer (%ix%i)\n", path.c_str(), width_, height_);
+      return -1;
+   }
+
+   std::vector<unsigned char> expected(width * height * 3);
+   file.read(reinterpret_cast<char*>(expected.data()), expected.size());
+
+   std::vector<unsigned char> pixels;
+   ReadPixels(pixels);
+
+   int differentPixels = 0;
+   for (size_t i = 0; i < pixels.size(); i += 3)
+   {
+      if (abs(pixels[i] - expected[i]) > tolerance ||
+         abs(pixels[i + 1] - expected[i + 1]) > tolerance ||
+         abs(pixels[i + 2] - expected[i + 2]) > tolerance)
+         differentPixels++;
+   }
+   return differentPixels;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+/// <summary>
+/// Offscreen render target with a colour and depth attachment.
+/// Used when running headless, the final frame can be written out or compared against a golden image.
+/// </summary>
+class FrameBuffer
+{
+public:
+   ~FrameBuffer();
+
+   bool Create(int width, int height);
+   void Bind() const;
+   static void Unbind();
+
+   // Reads back the colour attachment as tightly packed RGB rows, top row first
+   void ReadPixels(std::vector<unsigned char>& pixels) const;
+
+   // Writes the colour attachment as a binary PPM
+   bool SaveToFile(const std::string& path) const;
+   // Compares against a PPM written by SaveToFile, returns the number of differing pixels or -1 if the file can't be used
+   int CompareToFile(const std::string& path, int tolerance = 1) const;
+
+   int Width() const { return width_; }
+   int Height() const { return height_; }
+
+private:
+   GLuint fbo_ = 0;
+   GLuint colour_ = 0;
+   GLuint depth_ = 0;
+   int width_ = 0;
+   int height_ = 0;
+};
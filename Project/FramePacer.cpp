@@ -0,0 +1,93 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void FramePacer::SetTarget(const double target_frame_time)
+{
+   target_frame_time_ = target_frame_time;
+   next_frame_time_ = clock::now();
+}
+
+void FramePacer::WaitForNextFrame()
+{
+   auto now = clock::now();
+   current_work_time_ = static_cast<float>(static_cast<duration>(now - last_present_time_).count());
+
+   if (target_frame_time_ <= 0.0)
+      return;
+
+   next_frame_time_ += std::chrono::duration_cast<clock::duration>(duration(target_frame_time_));
+   // Fell more than a frame behind, start again from now rather than rushing frames out to catch up
+   if (next_frame_time_ < now)
+   {
+      next_frame_time_ = now;
+      return;
+   }
+
+   // Trust the OS a little more every frame, even frames too short to sleep in, so one bad oversleep can't leave us spinning forever
+   if (spin_margin_ > min_spin_margin)
+      spin_margin_ = std::max(min_spin_margin, spin_margin_ * 0.99);
+
+   // Sleep for the bulk of it
+   const double remaining = static_cast<duration>(next_frame_time_ - now).count();
+   if (remaining > spin_margin_)
+   {
+      const auto sleepUntil = next_frame_time_ - std::chrono::duration_cast<clock::duration>(duration(spin_margin_));
+      std::this_thread::sleep_until(sleepUntil);
+
+      // Learn how much the OS oversleeps, never spinning for more than a quarter of the frame
+      const double overshoot = static_cast<duration>(clock::now() - sleepUntil).count();
+      if (overshoot > spin_margin_ * 0.5)
+         spin_margin_ = std::min(overshoot * 2.0, target_frame_time_ * max_spin_fraction);
+   }
+
+   // Spin the rest
+   while (clock::now() < next_frame_time_)
+   {
+      std::this_thread::yield();
+   }
+}
+
+void FramePacer::FramePresented()
+{
+   const auto now = clock::now();
+   frame_history_[history_index_] = static_cast<float>(static_cast<duration>(now - last_present_time_).count());
+   work_history_[history_index_] = current_work_time_;
+   last_present_time_ = now;
+
+   history_index_ = (history_index_ + 1) % history_size;
+   if (history_count_ < history_size)
+      history_count_++;
+}
+
+FramePacer::Stats FramePacer::GetStats() const
+{
+   Stats stats;
+   if (history_count_ == 0)
+      return stats;
+
+   double total = 0.0;
+   double workTotal = 0.0;
+   stats.min = frame_history_[0];
+   stats.max = frame_history_[0];
+   for (int i = 0; i < history_count_; i++)
+   {
+      total += frame_history_[i];
+      workTotal += work_history_[i];
+      if (frame_history_[i] < stats.min) stats.min = frame_history_[i];
+      if (frame_history_[i] > stats.max) stats.max = frame_history_[i];
+   }
+   stats.average = static_cast<float>(total / history_count_);
+   stats.work_average = static_cast<float>(workTotal / history_count_);
+
+   double variance = 0.0;
+   for (int i = 0; i < history_count_; i++)
+   {
+      const double difference = frame_history_[i] - stats.average;
+      variance += difference * difference;
+   }
+   stats.jitter = static_cast<float>(sqrt(variance / history_count_));
+   return stats;
+}
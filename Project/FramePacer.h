@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+/// <summary>
+/// Frame limiter and frame time statistics.
+/// When capping, waits for the next frame by sleeping for most of the remaining time then spinning for the rest,
+/// the spin margin adapts to how much the OS oversleeps so we hit the target without burning a whole frame spinning.
+/// </summary>
+class FramePacer
+{
+public:
+   static constexpr int history_size = 240;
+
+   struct Stats
+   {
+      float average = 0.0f;
+      float min = 0.0f;
+      float max = 0.0f;
+      // Standard deviation of the frame time, how far frames stray from the average
+      float jitter = 0.0f;
+      // Time spent doing work before waiting, the true cost of a frame
+      float work_average = 0.0f;
+   };
+
+   // A target_frame_time of 0 or less runs uncapped, stats are still recorded
+   void SetTarget(double target_frame_time);
+
+   // Waits until the next frame is due, call just before presenting
+   void WaitForNextFrame();
+   // Records the frame, call just after presenting
+   void FramePresented();
+
+   Stats GetStats() const;
+   // Frame times (ms) oldest first, for plotting
+   const float* GetHistory() const { return frame_history_; }
+   int GetHistoryOffset() const { return history_index_; }
+
+private:
+   typedef std::chrono::steady_clock clock;
+   typedef std::chrono::duration<double, std::milli> duration;
+
+   double target_frame_time_ = 0.0;
+   clock::time_point next_frame_time_ = clock::now();
+   clock::time_point last_present_time_ = clock::now();
+
+   // How much earlier than the target to stop sleeping and start spinning, grows when a sleep overshoots and decays every frame
+   double spin_margin_ = 2.0;
+   static constexpr double min_spin_margin = 0.5;
+   // Largest spin margin as a fraction of the frame time
+   static constexpr double max_spin_fraction = 0.25;
+
+   float frame_history_[history_size]{ 0.0f };
+   float work_history_[history_size]{ 0.0f };
+   int history_index_ = 0;
+   int history_count_ = 0;
+   float current_work_time_ = 0.0f;
+};
@@ -6,16 +6,28 @@
 #include <backends/imgui_impl_opengl3.h>
 #include <SDL.h>
 
+#include "AllocationCounter.h"
+#include "BoardRenderer.h"
 #include "GameSettings.h"
 #include "ExtraInfoGUI.h"
+#include "FramePacer.h"
+#include "EngineCounters.h"
+#include "GpuTimer.h"
+#include "LatencyTracker.h"
+#include "Profiler.h"
+#include "ShaderManager.h"
 
 class GuiManager
 {
 public:
    SDL_Window* g_window;
    ExtraInfoGUI* g_extraInfo;
+   const FramePacer* g_framePacer;
+   const GpuTimer* g_gpuTimer;
+   const LatencyTracker* g_inputLatency;
 
-   GuiManager(GameSettings* settings, SDL_Window* window, SDL_GLContext* context, ExtraInfoGUI* guiInfo)
+   GuiManager(GameSettings* settings, SDL_Window* window, SDL_GLContext* context, ExtraInfoGUI* guiInfo, const FramePacer* framePacer, const GpuTimer* gpuTimer,
+              const LatencyTracker* inputLatency)
    {
       settings_ = settings;
 
@@ -28,12 +40,23 @@ public:
       ImGui_ImplOpenGL3_Init();
 
       g_extraInfo = guiInfo;
+      g_framePacer = framePacer;
+      g_gpuTimer = gpuTimer;
+      g_inputLatency = inputLatency;
 
       ImGui::SetWindowSize("Debug Window", ImVec2(205, 82));
       ImGui::SetWindowPos("Debug Window", ImVec2(474, 532));
 
       ImGui::SetWindowSize("Information", ImVec2(417, 200));
       ImGui::SetWindowPos("Information", ImVec2(18, 515));
+
+      ImGui::SetWindowSize("Profiler", ImVec2(520, 360));
+      ImGui::SetWindowPos("Profiler", ImVec2(18, 18));
+      ImGui::SetWindowCollapsed("Profiler", true);
+
+      ImGui::SetWindowSize("Engine Counters", ImVec2(330, 360));
+      ImGui::SetWindowPos("Engine Counters", ImVec2(372, 18));
+      ImGui::SetWindowCollapsed("Engine Counters", true);
       g_window = window;
    }
 
@@ -51,6 +74,26 @@ public:
       ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
    }
 
+   /// <summary>
+   /// Monitor view, each board's score and moves over its top left corner. Drawn behind the windows in ImGui's single draw.
+   /// </summary>
+   void DrawBoardTiles(const BoardSnapshot& snapshot) const
+   {
+      if (snapshot.tiles.empty())
+         return;
+      const BoardRenderer::Layout layout = BoardRenderer::GetLayout(settings_->screen_size, snapshot.world_width, snapshot.world_height);
+      ImDrawList* drawList = ImGui::GetBackgroundDrawList();
+      char label[32];
+      for (const BoardSnapshot::BoardTile& tile : snapshot.tiles)
+      {
+         snprintf(label, sizeof(label), "%i pts %i moves", tile.score, tile.moves);
+         const ImVec2 position(layout.origin.x + tile.x * layout.cell_pitch, layout.origin.y + tile.y * layout.cell_pitch);
+         const ImVec2 size = ImGui::CalcTextSize(label);
+         drawList->AddRectFilled(position, ImVec2(position.x + size.x + 4.0f, position.y + size.y), 0xA0000000);
+         drawList->AddText(ImVec2(position.x + 2.0f, position.y), 0xFFFFFFFF, label);
+      }
+   }
+
    void DrawFrameData()
    {
       ImGui::Begin("Information");
@@ -67,19 +110,164 @@ public:
       ImGui::Text("Key 'L': Toggle AI log");
       ImGui::Text("Key 'P': Print world to console");
       ImGui::Text("Key 'Space': Toggle between 50ms and 250ms Game Step Time");
+      ImGui::Text("Key 'R': Reset the board");
+      ImGui::Text("Key 'T': Export Chrome trace");
+
+      ImGui::End();
+   }
+
+   /// <summary>
+   /// Last frame of every profiled thread as a timeline and a zone hierarchy, with each zone's p50/p99 and history.
+   /// </summary>
+   void DrawProfiler()
+   {
+      ImGui::Begin("Profiler");
+#ifndef ENABLE_PROFILER
+      ImGui::Text("Build with ENABLE_PROFILER defined to record zones");
+#endif
+      for (Profiler::ThreadProfile* thread : Profiler::Instance()->GetThreads())
+      {
+         if (!thread->is_thread)
+            continue;
+         std::lock_guard<std::mutex> lock(thread->mutex);
+         ImGui::PushID(thread);
+         if (ImGui::CollapsingHeader(thread->name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+         {
+            ImGui::Text("Frame: %0.3fms", thread->last_frame_time);
+            DrawProfilerTimeline(*thread);
+
+            if (ImGui::BeginTable("Zones", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+            {
+               ImGui::TableSetupColumn("Zone");
+               ImGui::TableSetupColumn("ms");
+               ImGui::TableSetupColumn("p50");
+               ImGui::TableSetupColumn("p99");
+               ImGui::TableSetupColumn("History");
+               ImGui::TableHeadersRow();
+
+               for (const Profiler::Zone& zone : thread->last_frame_zones)
+               {
+                  const Profiler::ZoneHistory* history = thread->FindZoneHistory(zone.name);
+                  if (!history)
+                     continue;
+                  ImGui::TableNextRow();
+                  ImGui::TableNextColumn();
+                  ImGui::Text("%*s%s", zone.depth * 2, "", zone.name);
+                  ImGui::TableNextColumn();
+                  ImGui::Text("%0.3f", zone.duration);
+                  ImGui::TableNextColumn();
+                  ImGui::Text("%0.3f", Profiler::GetPercentile(*history, 0.5f));
+                  ImGui::TableNextColumn();
+                  ImGui::Text("%0.3f", Profiler::GetPercentile(*history, 0.99f));
+                  ImGui::TableNextColumn();
+                  ImGui::PushID(&zone);
+                  ImGui::PlotLines("##History", history->frame_totals, Profiler::history_size, history->history_index, nullptr, 0.0f, FLT_MAX, ImVec2(120, 16));
+                  ImGui::PopID();
+               }
+               ImGui::EndTable();
+            }
+         }
+         ImGui::PopID();
+      }
+      ImGui::End();
+   }
+
+   // Zones laid out along the frame, one row per depth
+   static void DrawProfilerTimeline(const Profiler::ThreadProfile& thread)
+   {
+      const float rowHeight = ImGui::GetTextLineHeight() + 2.0f;
+      int maxDepth = 0;
+      for (const Profiler::Zone& zone : thread.last_frame_zones)
+         maxDepth = (zone.depth > maxDepth ? zone.depth : maxDepth);
+
+      const ImVec2 origin = ImGui::GetCursorScreenPos();
+      const float width = ImGui::GetContentRegionAvail().x;
+      const float scale = width / static_cast<float>(thread.last_frame_time > 0.0 ? thread.last_frame_time : 1.0);
+      ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+      for (const Profiler::Zone& zone : thread.last_frame_zones)
+      {
+         const ImVec2 min(origin.x + static_cast<float>(zone.start) * scale, origin.y + zone.depth * rowHeight);
+         const ImVec2 max(min.x + static_cast<float>(zone.duration) * scale + 1.0f, min.y + rowHeight - 1.0f);
+         // Colour picked from the name, so a zone keeps its colour between frames
+         const ImU32 colour = static_cast<ImU32>(std::hash<const void*>()(zone.name)) | 0xFF808080;
+         drawList->AddRectFilled(min, max, colour);
+         if (ImGui::CalcTextSize(zone.name).x < max.x - min.x)
+            drawList->AddText(ImVec2(min.x + 2.0f, min.y + 1.0f), 0xFF000000, zone.name);
+         if (ImGui::IsMouseHoveringRect(min, max))
+            ImGui::SetTooltip("%s %0.3fms", zone.name, zone.duration);
+      }
+      ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+   }
+
+   void DrawEngineCounters()
+   {
+      ImGui::Begin("Engine Counters");
+      EngineCounters* counters = EngineCounters::Instance();
 
+      if (ImGui::BeginTable("Counters", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+      {
+         ImGui::TableSetupColumn("Counter");
+         ImGui::TableSetupColumn("Total");
+         ImGui::TableSetupColumn("Per Second");
+         ImGui::TableHeadersRow();
+         for (int i = 0; i < EngineCounters::counter_count; i++)
+         {
+            const auto counter = static_cast<EngineCounter>(i);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", EngineCounters::GetName(counter));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(counters->Total(counter)));
+            ImGui::TableNextColumn();
+            ImGui::Text("%0.1f", counters->GetRate(counter));
+         }
+         ImGui::EndTable();
+      }
+
+      const uint64_t moves = counters->Total(EngineCounter::Moves);
+      const uint64_t searches = counters->Total(EngineCounter::LegalMoveSearches);
+      ImGui::Text("Avg Cascade Depth: %0.2f", moves > 0 ? static_cast<double>(counters->Total(EngineCounter::CascadeRounds)) / moves : 0.0);
+      ImGui::Text("Avg Legal Move Search: %0.2fus", searches > 0 ? counters->Total(EngineCounter::LegalMoveSearchNanoseconds) / 1000.0 / searches : 0.0);
       ImGui::End();
    }
 
    void DrawGui()
    {
       DrawFrameData();
+      DrawProfiler();
+      DrawEngineCounters();
       ImGui::Begin("Debug Window");
       ImGui::Text("Screen Size: W-%i\tH-%i", settings_->screen_size.x, settings_->screen_size.y);
 
 
       ImGui::Text("Target FPS %0.2f", settings_->target_frames_per_second);
       ImGui::Text("Max Frame Delay: %0.2f", settings_->calculated_frame_delay);
+      ImGui::Text("Fixed Step: %0.2fms Alpha: %0.2f", g_extraInfo->fixed_step_time, g_extraInfo->fixed_interpolation);
+      ImGui::Text("Fixed Step Cap Hits: %u", g_extraInfo->fixed_step_cap_hits);
+      ImGui::Text("Simulated: %0.1fs (x%0.1f)%s", g_extraInfo->simulation_seconds, g_extraInfo->simulation_speed, settings_->turbo_simulation ? " Turbo" : "");
+
+      const FramePacer::Stats frameStats = g_framePacer->GetStats();
+      ImGui::Text("Frame: %0.2fms (%0.2f-%0.2f) Work: %0.2fms", frameStats.average, frameStats.min, frameStats.max, frameStats.work_average);
+      ImGui::Text("Frame Jitter: %0.3fms", frameStats.jitter);
+      const LatencyTracker::Stats latencyStats = g_inputLatency->GetStats();
+      if (latencyStats.samples > 0)
+         ImGui::Text("Input Latency: p50 %0.0fms p95 %0.0fms p99 %0.0fms Max %0.0fms", latencyStats.p50, latencyStats.p95, latencyStats.p99, latencyStats.max);
+      else
+         ImGui::Text("Input Latency: press 'A' to measure");
+      ImGui::PlotLines("##FrameTimes", g_framePacer->GetHistory(), FramePacer::history_size, g_framePacer->GetHistoryOffset(), nullptr, 0.0f, settings_->calculated_frame_delay * 2.0f);
+
+      if (g_gpuTimer->IsSupported())
+      {
+         for (int pass = 0; pass < g_gpuTimer->PassCount(); pass++)
+            ImGui::Text("GPU %s: %0.3fms (avg %0.3f)", g_gpuTimer->GetPassName(pass), g_gpuTimer->GetPassTime(pass), g_gpuTimer->GetPassAverage(pass));
+         ImGui::Text("GPU Queries Dropped: %u", g_gpuTimer->GetDroppedCount());
+      }
+      else
+         ImGui::Text("GPU timer queries not supported");
+      ImGui::Text("Allocations: %llu (%0.1fMB) Frame: %llu Fixed Step: %0.2f", static_cast<unsigned long long>(AllocationCounter::Total()),
+                  AllocationCounter::TotalBytes() / (1024.0 * 1024.0), static_cast<unsigned long long>(g_extraInfo->frame_allocations), g_extraInfo->fixed_step_allocations);
+      ImGui::Text("Program Cache: %i loaded, %i compiled", ShaderManager::Instance()->GetProgramCacheHits(), ShaderManager::Instance()->GetProgramCacheMisses());
       ImGui::End();
    }
 
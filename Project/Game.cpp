@@ -1,5 +1,10 @@
 #include "Game.h"
 
+#include <algorithm>
+
+#include "AllocationCounter.h"
+#include "EngineCountersFile.h"
+
 typedef ShaderManager::ShaderTypes ShaderType;
 
 bool Game::Initialize(SDL_GLContext* gl_context, SDL_Window* gl_window, GameSettings* settings)
@@ -13,19 +18,64 @@ bool Game::Initialize(SDL_GLContext* gl_context, SDL_Window* gl_window, GameSett
 
    glViewport(0, 0, settings->screen_size.x, settings->screen_size.y);
 
-   if (!ShaderManager::Instance()->CompileShader("orthoWorld", ShaderType::Vertex, "shaders/orthoWorld.vert"))
+   // Programs are only submitted here, the driver compiles them while the rest of startup and the board generation runs
+   if (!ShaderManager::Instance()->AddShaderSource("orthoWorld", ShaderType::Vertex, "shaders/orthoWorld.vert"))
       printf("Failed to generate Vertex Shader");
-   if (!ShaderManager::Instance()->CompileShader("orthoWorld", ShaderType::Fragment, "shaders/orthoWorld.frag"))
+   if (!ShaderManager::Instance()->AddShaderSource("orthoWorld", ShaderType::Fragment, "shaders/orthoWorld.frag"))
       printf("Failed to generate Frag Shader");
 
-   defaultShader = ShaderManager::Instance()->CreateShaderProgram("orthoWorld", false);
+   defaultShader = ShaderManager::Instance()->SubmitShaderProgram("orthoWorld", false);
    game_settings->default_shader = defaultShader;
 
+   if (!ShaderManager::Instance()->AddShaderSource("orthoBoard", ShaderType::Vertex, "shaders/orthoBoard.vert"))
+      printf("Failed to generate Board Vertex Shader");
+   if (!ShaderManager::Instance()->AddShaderSource("orthoBoard", ShaderType::Fragment, "shaders/orthoBoard.frag"))
+      printf("Failed to generate Board Frag Shader");
+
+   game_settings->board_shader = ShaderManager::Instance()->SubmitShaderProgram("orthoBoard", false);
+
+   if (gpu_timer.Initialize())
+   {
+      gpu_pass_clear = gpu_timer.AddPass("Clear");
+      gpu_pass_board = gpu_timer.AddPass("Board");
+      gpu_pass_gui = gpu_timer.AddPass("ImGui");
+   }
+
+   fixed_scheduler = FixedStepScheduler(game_settings->fixed_update_time, game_settings->max_fixed_updates_per_frame);
+
+   if (game_settings->turbo_simulation && !game_settings->headless && !game_settings->threaded_simulation)
+   {
+      printf("Turbo simulation needs its own thread, enabling threaded_simulation\n");
+      game_settings->threaded_simulation = true;
+   }
+   // Headless always steps virtual time, so runs are the same no matter how long frames take
+   if (game_settings->turbo_simulation || game_settings->headless)
+      simulation_clock = &virtual_clock;
+
+   // VSync paces itself in the swap, only the capped mode needs us to wait
+   if (game_settings->frame_pacing_mode == FramePacingMode::Capped && game_settings->target_frames_per_second > 0.0f)
+      frame_pacer.SetTarget(game_settings->calculated_frame_delay);
+
    match3 = new Match3(settings);
+   if (game_settings->monitor_boards > 1)
+      board_grid = new BoardGrid(settings, match3);
+   board_renderer = new BoardRenderer(settings);
    player = new Player();
 
-   // Initialize ImGUI
-   gui_manager = new GuiManager(game_settings, g_window, g_context, &match3->g_extraInfo);
+   if (game_settings->headless)
+   {
+      // No window to draw to, everything goes into an offscreen framebuffer instead
+      offscreen_target = new FrameBuffer();
+      if (!offscreen_target->Create(settings->screen_size.x, settings->screen_size.y))
+         return false;
+      offscreen_target->Bind();
+      match3->g_print_ai_moves = false;
+   }
+   else
+   {
+      // Initialize ImGUI
+      gui_manager = new GuiManager(game_settings, g_window, g_context, &render_info, &frame_pacer, &gpu_timer, &input_latency);
+   }
 
    // Input
    input_manager = InputManager::Instance();
@@ -37,6 +87,7 @@ bool Game::Initialize(SDL_GLContext* gl_context, SDL_Window* gl_window, GameSett
    printf("Key 'L': Toggle AI log");
    printf("Key 'P': Print world to console");
    printf("Key 'Space': Toggles AI Lock (Steps without 'A' input)");
+   printf("Key 'T': Export Chrome trace");
 
    return true;
 }
@@ -49,72 +100,433 @@ void Game::Run()
 
    auto deltaClock = clock::now();
    double deltaTime = 0.0;
-   double fixedRemainingTime = 0.0;
 
-   //? Debug Info
-   auto frameStart = clock::now();
-   auto secondCounter = clock::now();
-   int frameCounter = 0;
-
-   std::vector<GameObject*> gameObjects;
-   // Match 3 Specific
-   match3->Start();
-   player->NewGame(match3);
-
-   gameObjects.push_back(match3);
-   gameObjects.push_back(player);
+   PROFILE_THREAD_NAME("Main");
+   StartSimulation();
 
+   uint64_t frameStartAllocations = AllocationCounter::ThisThread();
    while (!input_manager->IsShuttingDown())
    {
+      // Previous frame ends here, before any zones are opened for this one
+      PROFILE_END_FRAME();
+      render_info.frame_allocations = AllocationCounter::ThisThread() - frameStartAllocations;
+      frameStartAllocations = AllocationCounter::ThisThread();
       deltaTime = static_cast<duration>(clock::now() - deltaClock).count();
       deltaClock = clock::now();
-      frameStart = clock::now();
-
-      fixedRemainingTime += deltaTime;
-
-      uint8_t frameFixedStepCounter = 0;
-      while (fixedRemainingTime > game_settings->fixed_update_time) {
-         fixedRemainingTime -= game_settings->fixed_update_time;
-
-         // Prevents lockup of game during intensive updates, hopefully allow recovery.
-         frameFixedStepCounter++;
-         if (frameFixedStepCounter >= game_settings->max_fixed_updates_per_frame)
-            break;
-      }
 
       //? ======
       //! Update
       input_manager->Update();
       if (input_manager->IsShuttingDown()) break;
 
-      for (auto* gameObject : gameObjects)
+      if (input_manager->ConsumeKeyPress(KeyCode::T))
+         ExportTrace();
+
+      EngineCounters::Instance()->UpdateRates(real_clock.Now());
+      if (game_settings->counters_export_interval > 0.0f && real_clock.Now() - last_counters_export_time > game_settings->counters_export_interval * 1000.0)
       {
-         gameObject->Update(deltaTime);
+         ExportCounters();
+         last_counters_export_time = real_clock.Now();
       }
 
-      if (input_manager->GetKeyDown(KeyCode::L))
-         match3->g_print_ai_moves = !match3->g_print_ai_moves;
-      if (input_manager->GetKeyDown(KeyCode::P))
-         match3->PrintWorldAsText();
+      if (!game_settings->threaded_simulation)
+         UpdateSimulation(deltaTime);
 
       //? ======
       //! Render
+      PROFILE_SCOPE("Render");
+      // Picks up programs that finished compiling, the board is drawn with a stand-in until they are ready
+      ShaderManager::Instance()->PollPrograms();
+      // Pick up the latest board the simulation has published, if there is a new one
+      if (board_snapshots.Consume())
+      {
+         const uint64_t frameAllocations = render_info.frame_allocations;
+         render_info = board_snapshots.ReadBuffer().extra_info;
+         render_info.frame_allocations = frameAllocations;
+         const BoardSnapshot& published = board_snapshots.ReadBuffer();
+         if (published.fixed_steps > 0)
+            render_info.fixed_step_allocations = static_cast<float>(published.fixed_step_allocations) / published.fixed_steps;
+      }
+      const BoardSnapshot& snapshot = board_snapshots.ReadBuffer();
+      const float interpolation = GetInterpolation(snapshot);
+      render_info.fixed_step_time = static_cast<float>(fixed_scheduler.StepTime());
+      render_info.fixed_interpolation = interpolation;
+      render_info.fixed_step_cap_hits = snapshot.fixed_step_cap_hits;
+      render_info.simulation_seconds = static_cast<float>(snapshot.simulation_time / 1000.0);
+      const double realTime = real_clock.Now() - real_start_time;
+      render_info.simulation_speed = static_cast<float>(realTime > 0.0 ? snapshot.simulation_time / realTime : 0.0);
+
       // Clear Screen
+      gpu_timer.Begin(gpu_pass_clear);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      gpu_timer.End();
 
-      match3->Draw(&main_cam);
+      gpu_timer.Begin(gpu_pass_board);
+      board_renderer->Draw(&main_cam, snapshot, simulation_clock->Now() - simulation_start_time);
+      gpu_timer.End();
 
-      gui_manager->NewGuiFrame();
+      {
+         PROFILE_SCOPE("ImGui Build");
+         gui_manager->NewGuiFrame();
+         gui_manager->DrawBoardTiles(snapshot);
+         gui_manager->DrawGui();
+      }
+      {
+         PROFILE_SCOPE("ImGui Render");
+         gpu_timer.Begin(gpu_pass_gui);
+         gui_manager->FinishGuiFrame();
+         gpu_timer.End();
+      }
+      {
+         PROFILE_SCOPE("Frame Pacer Wait");
+         frame_pacer.WaitForNextFrame();
+      }
+      {
+         PROFILE_SCOPE("SDL_GL_SwapWindow");
+         SDL_GL_SwapWindow(g_window);
+      }
+      frame_pacer.FramePresented();
+      RecordInputLatency(snapshot);
+      gpu_timer.EndFrame();
+   }
+
+   if (simulation_thread.joinable())
+   {
+      is_simulation_running = false;
+      simulation_thread.join();
+   }
+   FinishReplay();
+
+   if (!game_settings->trace_path.empty())
+      ExportTrace();
+   ExportCounters();
 
-      gui_manager->DrawGui();
+   //TODO Should do some cleanup for destruction?
+}
+
+// Starts the game, and the simulation thread if enabled. Rendering only ever reads published snapshots after this.
+void Game::StartSimulation()
+{
+   // Match 3 Specific
+   match3->Start();
+   player->NewGame(match3, &command_queue);
 
+   if (game_settings->record_replay)
+   {
+      std::string path = game_settings->replay_record_path;
+      if (path.empty())
+      {
+         const std::filesystem::path replayPath = IO::get_data_path() / "replays";
+         std::error_code error;
+         std::filesystem::create_directories(replayPath, error);
+         path = (replayPath / ("session_" + std::to_string(time(0)) + ".m3r")).string();
+      }
+      replay_recorder = new ReplayRecorder(path, static_cast<uint16_t>(game_settings->replay_keyframe_interval));
+      replay_recorder->Begin(*match3, *game_settings);
+      match3->SetRecorder(replay_recorder);
+   }
 
-      gui_manager->FinishGuiFrame();
+   game_objects.push_back(match3);
+   game_objects.push_back(player);
+   if (board_grid)
+   {
+      board_grid->Start();
+      game_objects.push_back(board_grid);
+   }
 
+   // Nobody could keep up pressing 'A', so the AI plays by itself. The monitor view is for watching the AI, so it does too.
+   if (game_settings->turbo_simulation || board_grid)
+      player->SetAutoPlay(true);
 
-      SDL_GL_SwapWindow(g_window);
+   simulation_start_time = simulation_clock->Now();
+   real_start_time = real_clock.Now();
+   last_counters_export_time = real_start_time;
+   EngineCounters::Instance()->UpdateRates(real_start_time);
+   PublishSnapshot();
 
+   if (game_settings->threaded_simulation)
+   {
+      is_simulation_running = true;
+      simulation_thread = std::thread(&Game::SimulationLoop, this);
    }
+}
 
-   //TODO Should do some cleanup for destruction?
+void Game::SimulationLoop()
+{
+   typedef std::chrono::duration<double, std::milli> duration;
+
+   PROFILE_THREAD_NAME("Simulation");
+
+   double lastTime = simulation_clock->Now();
+   while (is_simulation_running)
+   {
+      // Turbo doesn't wait for time to pass, it just moves the clock on by a fixed step every tick
+      if (game_settings->turbo_simulation)
+         virtual_clock.Advance(fixed_scheduler.StepTime());
+
+      const double now = simulation_clock->Now();
+      const double deltaTime = now - lastTime;
+      lastTime = now;
+
+      UpdateSimulation(deltaTime);
+      PROFILE_END_FRAME();
+
+      // Nothing to do until the next fixed step is due
+      if (!game_settings->turbo_simulation)
+         std::this_thread::sleep_for(duration(fixed_scheduler.TimeUntilNextStep()));
+   }
+}
+
+void Game::UpdateSimulation(const double delta_time)
+{
+   PROFILE_SCOPE("Simulation");
+   // Input and other per-update work first, so anything it requests is applied by this update's fixed steps
+   for (auto* gameObject : game_objects)
+   {
+      gameObject->Update(delta_time);
+   }
+
+   const int fixedSteps = fixed_scheduler.Advance(delta_time);
+   const ScopedAllocationCount stepAllocations;
+   for (int step = 0; step < fixedSteps; step++)
+   {
+      ApplyCommands();
+      for (auto* gameObject : game_objects)
+      {
+         gameObject->FixedUpdate();
+      }
+   }
+   fixed_steps_since_publish += fixedSteps;
+   fixed_step_allocations += stepAllocations.Count();
+
+   // Turbo ticks far faster than anything can be shown, so only publish often enough for the renderer.
+   // Changed cells keep building up in the meantime, so the renderer still gets everything that changed.
+   if (game_settings->turbo_simulation && game_settings->threaded_simulation)
+   {
+      const double now = real_clock.Now();
+      if (now - last_publish_time < turbo_publish_interval)
+         return;
+      last_publish_time = now;
+   }
+
+   PublishSnapshot();
+}
+
+// Hands the current board to the renderer, cells are only copied if they have changed.
+void Game::PublishSnapshot()
+{
+   PROFILE_SCOPE("Game::PublishSnapshot");
+   BoardSnapshot& snapshot = board_snapshots.WriteBuffer();
+   if (board_grid)
+      board_grid->Capture(snapshot, ++snapshot_sequence);
+   else
+      snapshot.Capture(*match3, ++snapshot_sequence);
+   snapshot.published_time = simulation_clock->Now();
+   snapshot.simulation_time = snapshot.published_time - simulation_start_time;
+   snapshot.fixed_alpha = fixed_scheduler.Alpha();
+   snapshot.fixed_step_cap_hits = fixed_scheduler.CapHits();
+   snapshot.fixed_steps = fixed_steps_since_publish;
+   snapshot.fixed_step_allocations = fixed_step_allocations;
+   fixed_steps_since_publish = 0;
+   fixed_step_allocations = 0;
+   if (board_grid)
+      board_grid->ClearChangedCells();
+   else
+      match3->ClearChangedCells();
+   board_snapshots.Publish();
+
+   // Only one press is tracked at a time, presses played while one is still waiting to be shown aren't sampled
+   uint64_t noInput = 0;
+   if (played_input_time != 0)
+      unpresented_input.compare_exchange_strong(noInput, (static_cast<uint64_t>(snapshot_sequence) << 32) | played_input_time, std::memory_order_release);
+   played_input_time = 0;
+}
+
+// Applies everything controllers have submitted since the last fixed step, the only place the game is changed from outside
+void Game::ApplyCommands()
+{
+   Command command;
+   while (command_queue.Pop(command))
+   {
+      match3->ApplyCommand(command);
+      if (played_input_time == 0)
+         played_input_time = command.input_time;
+   }
+}
+
+// Call after presenting a frame drawn from snapshot, samples the latency of a played key press if this frame is the first to show it
+void Game::RecordInputLatency(const BoardSnapshot& snapshot)
+{
+   const uint64_t input = unpresented_input.load(std::memory_order_acquire);
+   if (input == 0 || static_cast<Uint32>(input >> 32) > snapshot.sequence)
+      return;
+
+   const float latency = static_cast<float>(SDL_GetTicks() - static_cast<Uint32>(input));
+   input_latency.AddSample(latency);
+   PROFILE_LATENCY_EVENT("Input to Photon", Profiler::GetTimeMilliseconds() - latency, latency);
+   unpresented_input.store(0, std::memory_order_release);
+}
+
+float Game::GetInterpolation(const BoardSnapshot& snapshot) const
+{
+   const double sincePublished = simulation_clock->Now() - snapshot.published_time;
+   const double alpha = snapshot.fixed_alpha + sincePublished / fixed_scheduler.StepTime();
+   return static_cast<float>(alpha > 1.0 ? 1.0 : alpha);
+}
+
+void Game::ExportTrace() const
+{
+#ifdef ENABLE_PROFILER
+   const LatencyTracker::Stats latency = input_latency.GetStats();
+   Profiler::Instance()->SetTraceMetadata("input_latency_samples", static_cast<double>(latency.samples));
+   Profiler::Instance()->SetTraceMetadata("input_latency_p50_ms", latency.p50);
+   Profiler::Instance()->SetTraceMetadata("input_latency_p95_ms", latency.p95);
+   Profiler::Instance()->SetTraceMetadata("input_latency_p99_ms", latency.p99);
+   Profiler::Instance()->SetTraceMetadata("input_latency_max_ms", latency.max);
+   Profiler::Instance()->ExportTrace(game_settings->trace_path.empty() ? "trace.json" : game_settings->trace_path);
+#else
+   printf("Traces need a build with ENABLE_PROFILER defined\n");
+#endif
+}
+
+void Game::FinishReplay()
+{
+   if (!replay_recorder)
+      return;
+   match3->SetRecorder(nullptr);
+   replay_recorder->Finish(*match3);
+   delete replay_recorder;
+   replay_recorder = nullptr;
+}
+
+void Game::ExportCounters() const
+{
+   const std::filesystem::path& dataPath = IO::get_data_path();
+   std::error_code error;
+   std::filesystem::create_directories(dataPath, error);
+
+   EngineCountersFile countersFile;
+   countersFile.elapsed_seconds = EngineCounters::Instance()->GetElapsedSeconds(real_clock.Now());
+   countersFile.StartSave(countersFile.FilePath().c_str());
+   EngineCounters::Instance()->AppendCsv((dataPath / "engine_counters.csv").string(), real_clock.Now());
+}
+
+int Game::RunHeadless()
+{
+   typedef std::chrono::steady_clock clock;
+   typedef std::chrono::duration<double, std::milli> duration;
+
+   // Everything runs in order on this thread, so the same seed always gives the same result
+   game_settings->threaded_simulation = false;
+   PROFILE_THREAD_NAME("Main");
+   StartSimulation();
+   // Nobody is around to press 'A', so the AI plays by itself
+   player->SetAutoPlay(true);
+   // Every frame has to be drawn the same way each run, so don't start until every program has linked
+   ShaderManager::Instance()->FinishPrograms();
+
+   // Fixed delta, so the same seed always produces the same frames
+   const double deltaTime = game_settings->calculated_frame_delay;
+
+   double drawTimeTotal = 0.0;
+   double drawTimeMax = 0.0;
+
+   // Buffers grow to fit during the first frames, after that nothing should need the heap
+   const int warmupFrames = std::min(60, game_settings->headless_frames / 2);
+   uint64_t steadyFrameAllocations = 0;
+   uint64_t steadyStepAllocations = 0;
+   int steadyFramesAllocating = 0;
+   int steadySteps = 0;
+
+   for (int frame = 0; frame < game_settings->headless_frames; frame++)
+   {
+      PROFILE_END_FRAME();
+      const ScopedAllocationCount frameAllocations;
+      virtual_clock.Advance(deltaTime);
+      UpdateSimulation(deltaTime);
+      board_snapshots.Consume();
+      if (frame >= warmupFrames)
+      {
+         steadyStepAllocations += board_snapshots.ReadBuffer().fixed_step_allocations;
+         steadySteps += board_snapshots.ReadBuffer().fixed_steps;
+      }
+
+      PROFILE_SCOPE("Render");
+
+      const auto drawStart = clock::now();
+
+      gpu_timer.Begin(gpu_pass_clear);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      gpu_timer.End();
+      gpu_timer.Begin(gpu_pass_board);
+      board_renderer->Draw(&main_cam, board_snapshots.ReadBuffer(), simulation_clock->Now() - simulation_start_time);
+      gpu_timer.End();
+      // Wait on the GPU so the timing includes the actual rendering
+      glFinish();
+
+      const double drawTime = static_cast<duration>(clock::now() - drawStart).count();
+      drawTimeTotal += drawTime;
+      if (drawTime > drawTimeMax)
+         drawTimeMax = drawTime;
+
+      // Only paced with --pacing=3, otherwise runs as fast as it can
+      frame_pacer.WaitForNextFrame();
+      frame_pacer.FramePresented();
+      gpu_timer.EndFrame();
+
+      if (frame >= warmupFrames && frameAllocations.Count() > 0)
+      {
+         steadyFrameAllocations += frameAllocations.Count();
+         steadyFramesAllocating++;
+      }
+   }
+
+   const int frames = game_settings->headless_frames;
+   if (board_grid)
+      printf("Headless: Monitor view, %i boards in %i columns\n", board_grid->BoardCount(), board_grid->Columns());
+   printf("Headless: %i frames, Board %ix%i, Draw Avg: %0.3fms Max: %0.3fms\n", frames,
+          match3->GetRules()->world_width, match3->GetRules()->world_height,
+          (frames > 0 ? drawTimeTotal / frames : 0.0), drawTimeMax);
+   const FramePacer::Stats frameStats = frame_pacer.GetStats();
+   printf("Headless: Frame Avg: %0.3fms Min: %0.3fms Max: %0.3fms Jitter: %0.3fms\n",
+          frameStats.average, frameStats.min, frameStats.max, frameStats.jitter);
+   for (int pass = 0; pass < gpu_timer.PassCount(); pass++)
+   {
+      if (pass != gpu_pass_gui)
+         printf("Headless: GPU %s Avg: %0.3fms\n", gpu_timer.GetPassName(pass), gpu_timer.GetPassAverage(pass));
+   }
+
+   FinishReplay();
+   if (!game_settings->trace_path.empty())
+      ExportTrace();
+   ExportCounters();
+
+   const int steadyFrames = frames - warmupFrames;
+   printf("Headless: Allocations after %i warmup frames: %llu in %i/%i frames, %llu in %i fixed steps (%llu total, %0.1fKB)\n", warmupFrames,
+          static_cast<unsigned long long>(steadyFrameAllocations), steadyFramesAllocating, steadyFrames,
+          static_cast<unsigned long long>(steadyStepAllocations), steadySteps,
+          static_cast<unsigned long long>(AllocationCounter::Total()), AllocationCounter::TotalBytes() / 1024.0);
+
+   int result = 0;
+   if (game_settings->audit_allocations && (steadyFrameAllocations > 0 || steadyStepAllocations > 0))
+   {
+      printf("Allocation audit failed: steady state frames and fixed steps should never allocate\n");
+      result = 1;
+   }
+   if (!game_settings->capture_path.empty() && !offscreen_target->SaveToFile(game_settings->capture_path))
+      result = 1;
+
+   if (!game_settings->compare_path.empty())
+   {
+      const int differentPixels = offscreen_target->CompareToFile(game_settings->compare_path);
+      if (differentPixels != 0)
+      {
+         printf("Golden image mismatch: %i pixels differ from %s\n", differentPixels, game_settings->compare_path.c_str());
+         result = 1;
+      }
+      else
+         printf("Golden image matches %s\n", game_settings->compare_path.c_str());
+   }
+
+   return result;
 }
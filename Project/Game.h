@@ -1,13 +1,27 @@
 #pragma once
 #include <SDL.h>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "GameSettings.h"
 #include "GUIManager.h"
 #include "ShaderManager.h"
 #include "InputManager.h"
 
+#include "BoardGrid.h"
+#include "BoardRenderer.h"
+#include "BoardSnapshot.h"
 #include "Camera.h"
+#include "Clock.h"
+#include "FixedStepScheduler.h"
+#include "FrameBuffer.h"
+#include "FramePacer.h"
+#include "GpuTimer.h"
+#include "LatencyTracker.h"
 #include "Match3.h"
 #include "Player.h"
+#include "Replay.h"
+#include "TripleBuffer.h"
 
 class Game
 {
@@ -19,12 +33,79 @@ class Game
    InputManager* input_manager;
 
    Match3* match3;
+   // Only created for the monitor view, holds match3 and the other boards shown with it
+   BoardGrid* board_grid = nullptr;
+   BoardRenderer* board_renderer;
    Player* player;
    Camera main_cam;
 
    GLint defaultShader;
 
+   // Render target used instead of the window when running headless
+   FrameBuffer* offscreen_target = nullptr;
+
+   // Simulation, owned by the simulation thread while it is running
+   std::vector<GameObject*> game_objects;
+   std::thread simulation_thread;
+   std::atomic<bool> is_simulation_running{ false };
+   FixedStepScheduler fixed_scheduler;
+
+   // Simulation time, virtual when running turbo or headless so it can run ahead of (or behind) real time
+   RealClock real_clock;
+   VirtualClock virtual_clock;
+   Clock* simulation_clock = &real_clock;
+   double simulation_start_time = 0.0;
+   double real_start_time = 0.0;
+   double last_publish_time = 0.0;
+   // Real time (ms) between snapshots when running turbo
+   static constexpr double turbo_publish_interval = 1.0;
+   double last_counters_export_time = 0.0;
+
+   // Latest board handed from the simulation to the renderer
+   TripleBuffer<BoardSnapshot> board_snapshots;
+   Uint32 snapshot_sequence = 0;
+   // Renderer side copy of the GUI info, read by GuiManager
+   ExtraInfoGUI render_info;
+   // Caps the frame rate when VSync is off, and keeps frame time stats for every mode
+   FramePacer frame_pacer;
+   // GPU time of each render pass, read back a few frames late
+   GpuTimer gpu_timer;
+   int gpu_pass_clear = -1;
+   int gpu_pass_board = -1;
+   int gpu_pass_gui = -1;
+   // Heap allocations made by fixed steps since the last snapshot was published
+   int fixed_steps_since_publish = 0;
+   uint64_t fixed_step_allocations = 0;
+   // Everything controllers want to change, drained at the start of each fixed step
+   CommandQueue command_queue;
+   // SDL timestamp of the oldest input applied since the last publish, simulation thread only
+   Uint32 played_input_time = 0;
+   // Oldest played key press waiting to be shown, (snapshot sequence << 32) | SDL timestamp, 0 when there isn't one.
+   // Set by the simulation when it publishes the move, cleared by the renderer once a frame showing that snapshot is swapped.
+   std::atomic<uint64_t> unpresented_input{ 0 };
+   // Input to photon, from the SDL event to the SDL_GL_SwapWindow that showed its move. Render thread only.
+   LatencyTracker input_latency;
+   // Records the session when record_replay is set, written out once the simulation stops
+   ReplayRecorder* replay_recorder = nullptr;
+
+   void StartSimulation();
+   void SimulationLoop();
+   void UpdateSimulation(double delta_time);
+   void ApplyCommands();
+   void PublishSnapshot();
+   void RecordInputLatency(const BoardSnapshot& snapshot);
+   // Interpolation (0-1) between the snapshot's fixed step and the next, at the time of rendering
+   float GetInterpolation(const BoardSnapshot& snapshot) const;
+   // Writes the recorded trace to trace_path, or trace.json if none was given
+   void ExportTrace() const;
+   // Writes engine counters to data/engine_counters.json and appends a row to data/engine_counters.csv
+   void ExportCounters() const;
+   // Call once the simulation has stopped
+   void FinishReplay();
+
 public:
    bool Initialize(SDL_GLContext* gl_context, SDL_Window* gl_window, GameSettings* settings);
    void Run();
+   // Runs a fixed number of frames offscreen, returns the process exit code
+   int RunHeadless();
 };
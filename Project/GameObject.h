@@ -20,9 +20,9 @@ public:
    {
    };
 
+   // Called at GameSettings::target_fixed_updates_per_second, all game state changes should happen here
    virtual void FixedUpdate()
    {
-      
    };
 
    virtual void Destroy()
@@ -33,5 +33,6 @@ public:
    //x  virtual void SubscribeInputs(InputHandler* inputHandler) {};
    //x  virtual void UpdateInput(const int eventType, const SDL_Event* _event) { };
 
-   virtual bool Draw(Camera* camera) { return false; };
+   // interpolation is how far (0-1) we are between the last FixedUpdate and the next
+   virtual bool Draw(Camera* camera, float interpolation) { return false; };
 };
@@ -1,14 +1,37 @@
 #pragma once
 #include <GL/glew.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 #include "Math.h"
 
 #include "ConfigFile.h"
 
 #include "Constants.h"
+
+enum class BoardRenderMode
+{
+   // One instance per cell, cells are rebuilt on the CPU as they change
+   Instanced = 0,
+   // Board uploaded as an integer texture, each pixel works out its own cell in the fragment shader
+   Texture = 1
+};
+
+enum class FramePacingMode
+{
+   VSync = 0,
+   // Tears instead of waiting when a frame is late, falls back to VSync if the driver doesn't support it
+   AdaptiveVSync = 1,
+   Uncapped = 2,
+   // VSync off, frames are limited to target_frames_per_second by FramePacer
+   Capped = 3
+};
+
 struct GameSettings
 {
    GLint default_shader;
+   GLint board_shader;
 
    /* Game Settings that will be global */
    IVec2 screen_size = IVec2(1280, 720);
@@ -25,6 +48,60 @@ struct GameSettings
    int cell_types_used = 5;
    IVec2 world_size = IVec2(8,8);
 
+   BoardRenderMode board_render_mode = BoardRenderMode::Instanced;
+
+   // 0 picks a new seed every run
+   Uint32 random_seed = 0;
+
+   bool threaded_simulation = true;
+
+   FramePacingMode frame_pacing_mode = FramePacingMode::VSync;
+
+   // Simulation ticks as fast as possible on a virtual clock, AI plays by itself. Needs threaded_simulation.
+   bool turbo_simulation = false;
+
+   // Seconds, 0 only writes the counters on exit
+   float counters_export_interval = 10.0f;
+
+   // Replay written when the simulation stops, to data/replays unless a path is given
+   bool record_replay = false;
+   std::string replay_record_path;
+   int replay_keyframe_interval = 32;
+   // Plays a replay back instead of running the game, optionally stopping at a move. Only set from the command line.
+   std::string replay_path;
+   int replay_seek_move = -1;
+
+   // Moves the AI looks ahead, 0 plays the first legal move found. Search memory is capped at ai_memory_cap_mb.
+   int ai_search_depth = 0;
+   int ai_memory_cap_mb = 16;
+   // AI searches on a worker thread, starting as soon as a move is made instead of once the board has settled
+   bool ai_background_search = true;
+
+   // Monitor view, this many boards play at once laid out in a grid. Only the first takes input, the rest play themselves.
+   int monitor_boards = 0;
+
+   // Headless, renders offscreen without a window. Only set from the command line.
+   bool headless = false;
+   int headless_frames = 600;
+   // Optional image of the final frame to write out, and a golden image to compare it against
+   std::string capture_path;
+   std::string compare_path;
+   // Fails the headless run if any frame or fixed step allocates once the first few frames have warmed everything up
+   bool audit_allocations = false;
+
+   // Benchmarks the board kernels instead of running the game. Only set from the command line.
+   bool benchmark = false;
+   bool benchmark_quick = false;
+   std::string benchmark_path = "benchmark.json";
+
+   // Session server for bots and load tests, "unix:path" or "tcp:port" (localhost). Only set from the command line.
+   std::string serve_address;
+   // Threads serving sessions, 0 uses one per core up to 4
+   int server_threads = 0;
+
+   // Chrome trace written on exit, 'T' writes one at any time (to trace.json if this is empty)
+   std::string trace_path;
+
    void LoadSettings(ConfigFile& config)
    {
       screen_size.x = config.screen_x;
@@ -43,5 +120,85 @@ struct GameSettings
       cell_types_used = config.cell_types_used;
 
       world_size = IVec2(config.world_size_x, config.world_size_y);
+
+      board_render_mode = static_cast<BoardRenderMode>(config.board_render_mode);
+
+      random_seed = config.random_seed;
+
+      threaded_simulation = config.threaded_simulation;
+
+      frame_pacing_mode = static_cast<FramePacingMode>(config.frame_pacing_mode);
+
+      turbo_simulation = config.turbo_simulation;
+
+      counters_export_interval = config.counters_export_interval;
+
+      replay_keyframe_interval = config.replay_keyframe_interval;
+      record_replay = config.record_replay;
+
+      ai_search_depth = config.ai_search_depth;
+      ai_memory_cap_mb = config.ai_memory_cap_mb;
+      ai_background_search = config.ai_background_search;
+
+      monitor_boards = config.monitor_boards;
    };
+
+   /// <summary>
+   /// Applies a single command line argument over the top of the config, returns false if it isn't recognised.
+   /// --headless --frames=N --seed=N --render-mode=N --pacing=N --turbo --trace=path --capture=path --compare=path
+   /// --benchmark[=path] --benchmark-quick --record=path --replay=path --replay-seek=N --audit-allocations
+   /// --ai-depth=N --serve=unix:path|tcp:port --server-threads=N --monitor=N
+   /// </summary>
+   bool LoadArgument(const char* argument)
+   {
+      if (strcmp(argument, "--headless") == 0)
+         headless = true;
+      else if (strncmp(argument, "--frames=", 9) == 0)
+         headless_frames = atoi(argument + 9);
+      else if (strncmp(argument, "--seed=", 7) == 0)
+         random_seed = static_cast<Uint32>(strtoul(argument + 7, nullptr, 10));
+      else if (strncmp(argument, "--render-mode=", 14) == 0)
+         board_render_mode = static_cast<BoardRenderMode>(atoi(argument + 14));
+      else if (strncmp(argument, "--pacing=", 9) == 0)
+         frame_pacing_mode = static_cast<FramePacingMode>(atoi(argument + 9));
+      else if (strcmp(argument, "--turbo") == 0)
+         turbo_simulation = true;
+      else if (strncmp(argument, "--trace=", 8) == 0)
+         trace_path = argument + 8;
+      else if (strcmp(argument, "--benchmark") == 0)
+         benchmark = true;
+      else if (strncmp(argument, "--benchmark=", 12) == 0)
+      {
+         benchmark = true;
+         benchmark_path = argument + 12;
+      }
+      else if (strcmp(argument, "--benchmark-quick") == 0)
+         benchmark = benchmark_quick = true;
+      else if (strncmp(argument, "--record=", 9) == 0)
+      {
+         record_replay = true;
+         replay_record_path = argument + 9;
+      }
+      else if (strncmp(argument, "--replay=", 9) == 0)
+         replay_path = argument + 9;
+      else if (strncmp(argument, "--replay-seek=", 14) == 0)
+         replay_seek_move = atoi(argument + 14);
+      else if (strncmp(argument, "--serve=", 8) == 0)
+         serve_address = argument + 8;
+      else if (strncmp(argument, "--server-threads=", 17) == 0)
+         server_threads = atoi(argument + 17);
+      else if (strncmp(argument, "--ai-depth=", 11) == 0)
+         ai_search_depth = atoi(argument + 11);
+      else if (strncmp(argument, "--monitor=", 10) == 0)
+         monitor_boards = atoi(argument + 10);
+      else if (strcmp(argument, "--audit-allocations") == 0)
+         audit_allocations = true;
+      else if (strncmp(argument, "--capture=", 10) == 0)
+         capture_path = argument + 10;
+      else if (strncmp(argument, "--compare=", 10) == 0)
+         compare_path = argument + 10;
+      else
+         return false;
+      return true;
+   }
 };
@@ -0,0 +1,97 @@
+#include "GpuTimer.h"
+
+#include <cstdio>
+
+#include "Profiler.h"
+
+GpuTimer::~GpuTimer()
+{
+   if (is_supported_)
+      glDeleteQueries(query_frames * max_passes, &queries_[0][0]);
+}
+
+bool GpuTimer::Initialize()
+{
+   // Core since 3.3, our shaders need that anyway
+   is_supported_ = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+   if (!is_supported_)
+   {
+      printf("Warning: GL timer queries not supported, GPU pass times will be unavailable\n");
+      return false;
+   }
+
+   glGenQueries(query_frames * max_passes, &queries_[0][0]);
+   return true;
+}
+
+int GpuTimer::AddPass(const char* name)
+{
+   if (pass_count_ >= max_passes)
+      return -1;
+   pass_names_[pass_count_] = name;
+   return pass_count_++;
+}
+
+void GpuTimer::Begin(const int pass)
+{
+   if (!is_supported_ || pass < 0 || active_pass_ != -1)
+      return;
+
+   // Still waiting on this slot from query_frames ago, skip the pass rather than wait on the GPU
+   if (is_pending_[frame_index_][pass])
+   {
+      dropped_count_++;
+      return;
+   }
+
+   glBeginQuery(GL_TIME_ELAPSED, queries_[frame_index_][pass]);
+   begin_times_[frame_index_][pass] = Profiler::GetTimeMilliseconds();
+   active_pass_ = pass;
+}
+
+void GpuTimer::End()
+{
+   if (active_pass_ == -1)
+      return;
+
+   glEndQuery(GL_TIME_ELAPSED);
+   is_pending_[frame_index_][active_pass_] = true;
+   active_pass_ = -1;
+}
+
+void GpuTimer::EndFrame()
+{
+   if (!is_supported_)
+      return;
+
+   frame_index_ = (frame_index_ + 1) % query_frames;
+   // Oldest frame first, so results arrive in order
+   for (int i = 0; i < query_frames; i++)
+      CollectResults((frame_index_ + i) % query_frames);
+}
+
+void GpuTimer::CollectResults(const int frame)
+{
+   for (int pass = 0; pass < pass_count_; pass++)
+   {
+      if (!is_pending_[frame][pass])
+         continue;
+
+      GLint isAvailable = GL_FALSE;
+      glGetQueryObjectiv(queries_[frame][pass], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+      if (isAvailable == GL_FALSE)
+         continue;
+
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(queries_[frame][pass], GL_QUERY_RESULT, &elapsed);
+      is_pending_[frame][pass] = false;
+
+      // Some drivers (llvmpipe) hand back garbage for the very first query, no pass takes a second
+      if (elapsed > 1000000000ull)
+         continue;
+
+      pass_time_[pass] = static_cast<float>(elapsed / 1000000.0);
+      PROFILE_GPU_EVENT(pass_names_[pass], begin_times_[frame][pass], pass_time_[pass]);
+      pass_average_[pass] = (pass_average_[pass] == 0.0f ? pass_time_[pass] : pass_average_[pass] * 0.95f + pass_time_[pass] * 0.05f);
+   }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <GL/glew.h>
+
+/// <summary>
+/// Times GPU passes with GL_TIME_ELAPSED queries.
+/// Queries are kept in a ring several frames deep and only read back once the GPU has finished with them,
+/// so timing never stalls the pipeline. Passes can't overlap, GL only allows one elapsed query at a time.
+/// </summary>
+class GpuTimer
+{
+public:
+   static constexpr int max_passes = 8;
+   // Frames a query has to come back before its slot is needed again
+   static constexpr int query_frames = 4;
+
+   ~GpuTimer();
+
+   // Returns false if timer queries aren't supported, Begin/End do nothing in that case
+   bool Initialize();
+
+   // Returns the pass index to Begin with, or -1 if there are already max_passes
+   int AddPass(const char* name);
+
+   void Begin(int pass);
+   void End();
+   // Moves on to the next slot in the ring and collects any results that have come back
+   void EndFrame();
+
+   bool IsSupported() const { return is_supported_; }
+   int PassCount() const { return pass_count_; }
+   const char* GetPassName(const int pass) const { return pass_names_[pass]; }
+   // Latest result, and a smoothed average, in milliseconds
+   float GetPassTime(const int pass) const { return pass_time_[pass]; }
+   float GetPassAverage(const int pass) const { return pass_average_[pass]; }
+   // Passes not timed because their query from query_frames ago still hadn't come back
+   unsigned int GetDroppedCount() const { return dropped_count_; }
+
+private:
+   void CollectResults(int frame);
+
+   bool is_supported_ = false;
+   GLuint queries_[query_frames][max_passes]{};
+   // CPU time each query was issued, where the pass is placed in traces
+   double begin_times_[query_frames][max_passes]{};
+   bool is_pending_[query_frames][max_passes]{};
+   int frame_index_ = 0;
+   int active_pass_ = -1;
+
+   const char* pass_names_[max_passes]{};
+   float pass_time_[max_passes]{};
+   float pass_average_[max_passes]{};
+   int pass_count_ = 0;
+   unsigned int dropped_count_ = 0;
+};
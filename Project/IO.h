@@ -1,6 +1,7 @@
 #pragma once
 #include <cassert>
 #include <SDL_filesystem.h>
+#include <SDL_stdinc.h>
 
 #include <filesystem>
 #include <cstdio>
@@ -9,11 +10,31 @@
 
 namespace IO
 {
-   inline std::filesystem::path get_executable_path() { return std::filesystem::path(SDL_GetBasePath()); }
+   // SDL_GetBasePath allocates a new string on every call that has to be freed, so it is only asked once
+   inline const std::string& get_base_path()
+   {
+      static const std::string basePath = []
+      {
+         char* path = SDL_GetBasePath();
+         std::string result = (path ? path : "");
+         SDL_free(path);
+         return result;
+      }();
+      return basePath;
+   }
+
+   inline std::filesystem::path get_executable_path() { return std::filesystem::path(get_base_path()); }
+
+   // Everything the game saves lives under here
+   inline const std::filesystem::path& get_data_path()
+   {
+      static const std::filesystem::path dataPath = get_executable_path() / "data";
+      return dataPath;
+   }
 
    inline std::filesystem::path get_file_path(const std::string& path)
    {
-      return std::filesystem::path(SDL_GetBasePath() + path);
+      return std::filesystem::path(get_base_path() + path);
    }
 
    inline bool does_full_path_exist(const std::filesystem::path& path)
@@ -25,7 +46,7 @@ namespace IO
    {
       if (use_sdl_base)
       {
-         return std::filesystem::exists(std::filesystem::path(SDL_GetBasePath() + file_path));
+         return std::filesystem::exists(std::filesystem::path(get_base_path() + file_path));
       }
       return std::filesystem::exists(file_path);
    }
@@ -46,7 +67,7 @@ namespace IO
    // Creates an empty file using the argument file, it will check to make sure directory exists prior.
    inline void create_file_if_not_exist(const std::string& file)
    {
-      const std::filesystem::path path = SDL_GetBasePath() + file;
+      const std::filesystem::path path = get_base_path() + file;
       if (does_file_exist(path.string(), false)) { return; }
       // Make sure directory exists
       create_directory(path.string());
@@ -60,7 +81,7 @@ namespace IO
       std::string content;
       if (does_file_exist(file, !needs_base))
       {
-         std::ifstream ifs((needs_base ? SDL_GetBasePath() + file : file));
+         std::ifstream ifs((needs_base ? get_base_path() + file : file));
          content = std::string(
             (std::istreambuf_iterator<char>(ifs)),
             (std::istreambuf_iterator<char>()));
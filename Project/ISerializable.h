@@ -1,4 +1,7 @@
 #pragma once
+#include <cstdio>
+#include <exception>
+
 #include "IO.h"
 #include <cereal/cereal.hpp> // for defer
 #include <cereal/details/helpers.hpp>
@@ -29,7 +32,7 @@ public:
    virtual bool StartSave(const char* path)
    {
       const auto saveType = SaveType();
-      const auto newPath = std::filesystem::path(IO::get_executable_path()).append("data/").append(path).
+      const auto newPath = std::filesystem::path(IO::get_data_path()).append(path).
          concat(SaveTypeName[static_cast<int>(saveType)]);
       std::ofstream os(newPath);
 
@@ -54,26 +57,35 @@ public:
    virtual bool StartLoad(const char* path, const bool on_fail_save = false)
    {
       const auto saveType = SaveType();
-      const auto newPath = std::filesystem::path(IO::get_executable_path()).append("data/").append(path).
+      const auto newPath = std::filesystem::path(IO::get_data_path()).append(path).
          concat(SaveTypeName[static_cast<int>(saveType)]);
       if (IO::does_full_path_exist(newPath))
       {
          std::ifstream fs(newPath);
          const auto saveType = SaveType();
-         switch (saveType)
+         // A file that isn't valid at all is left alone, whatever was loaded before the error is kept
+         try
+         {
+            switch (saveType)
+            {
+            case SaveTypes::XML:
+               Load(cereal::XMLInputArchive(fs));
+               return true;
+               break;
+            case SaveTypes::Binary:
+               Load(cereal::BinaryInputArchive(fs));
+               return true;
+               break;
+            case SaveTypes::Json:
+               Load(cereal::JSONInputArchive(fs));
+               return true;
+               break;
+            }
+         }
+         catch (const std::exception& exception)
          {
-         case SaveTypes::XML:
-            Load(cereal::XMLInputArchive(fs));
-            return true;
-            break;
-         case SaveTypes::Binary:
-            Load(cereal::BinaryInputArchive(fs));
-            return true;
-            break;
-         case SaveTypes::Json:
-            Load(cereal::JSONInputArchive(fs));
-            return true;
-            break;
+            printf("Failed to load %s: %s\n", newPath.string().c_str(), exception.what());
+            return false;
          }
          return true;
       }
@@ -1,7 +1,9 @@
 #pragma once
 #include <cmath>
+#include <type_traits>
 /// <summary>
 /// Container class that has 2 ints
+/// Plain value type, copies are just the two ints and nothing here touches the heap.
 /// </summary>
 struct IVec2
 {
@@ -9,14 +11,10 @@ public:
    int x = 0;
    int y = 0;
 
-   IVec2()
-   {
-   }
+   constexpr IVec2() = default;
 
-   IVec2(int x, int y)
+   constexpr IVec2(const int x, const int y) : x(x), y(y)
    {
-      this->x = x;
-      this->y = y;
    }
 
    template <class Archive>
@@ -25,67 +23,47 @@ public:
       archive(x, y);
    }
 
-   IVec2 operator +(const IVec2& other) const;
-   IVec2 operator -(const IVec2& other) const;
-   IVec2 operator =(const IVec2 other);
-   bool operator !=(const IVec2& other) const;
-   IVec2 operator *(const float rhs) const;
-
-   bool operator==(const IVec2& other) const
+   constexpr IVec2 operator +(const IVec2& other) const
    {
-      return (this->x == other.x && this->y == other.y);
+      return IVec2(x + other.x, y + other.y);
    }
 
-   IVec2(const IVec2& rhs)
+   constexpr IVec2 operator -(const IVec2& other) const
    {
-      this->x = rhs.x;
-      this->y = rhs.y;
+      return IVec2(x - other.x, y - other.y);
    }
 
-   static IVec2 Zero() { return IVec2(0, 0); };
-   static IVec2 Left() { return IVec2(-1, 0); };
-   static IVec2 Right() { return IVec2(1, 0); };
-   static IVec2 Up() { return IVec2(0, 1); };
-   static IVec2 Down() { return IVec2(0, -1); };
+   constexpr IVec2 operator *(const float rhs) const
+   {
+      return IVec2(static_cast<int>(x * rhs), static_cast<int>(y * rhs));
+   }
 
-   static IVec2 Lerp(IVec2 a, IVec2 b, float t);
-   static float Distance(IVec2 a, IVec2 b);
-};
+   constexpr bool operator==(const IVec2& other) const
+   {
+      return (this->x == other.x && this->y == other.y);
+   }
 
-inline IVec2 IVec2::operator=(const IVec2 other)
-{
-   this->x = other.x;
-   this->y = other.y;
-   return *this;
-}
+   constexpr bool operator !=(const IVec2& other) const
+   {
+      return !(*this == other);
+   }
 
-inline bool IVec2::operator!=(const IVec2& other) const
-{
-   return (this->x == other.x && this->y == other.y);
-}
+   static constexpr IVec2 Zero() { return IVec2(0, 0); };
+   static constexpr IVec2 Left() { return IVec2(-1, 0); };
+   static constexpr IVec2 Right() { return IVec2(1, 0); };
+   static constexpr IVec2 Up() { return IVec2(0, 1); };
+   static constexpr IVec2 Down() { return IVec2(0, -1); };
 
-inline IVec2 IVec2::operator*(const float rhs) const
-{
-   return *(new IVec2(static_cast<int>(this->x * rhs), static_cast<int>(this->y * rhs)));
-}
+   static constexpr IVec2 Lerp(const IVec2 a, const IVec2 b, const float t)
+   {
+      return a + (b - a) * t;
+   }
 
-inline IVec2 IVec2::Lerp(IVec2 a, IVec2 b, float t)
-{
-   IVec2 result = a + (b - a) * t;
-   return result;
-}
+   static float Distance(IVec2 a, IVec2 b);
+};
+static_assert(std::is_trivially_copyable<IVec2>::value, "IVec2 is passed around by value and copied with memcpy");
 
-inline float IVec2::Distance(IVec2 a, IVec2 b)
+inline float IVec2::Distance(const IVec2 a, const IVec2 b)
 {
    return sqrtf(powf(a.x - b.x, 2) + powf(a.y - b.y, 2));
 }
-
-inline IVec2 IVec2::operator+(const IVec2& other) const
-{
-   return *(new IVec2(this->x + other.x, this->y + other.y));
-}
-
-inline IVec2 IVec2::operator-(const IVec2& other) const
-{
-   return *(new IVec2(this->x - other.x, this->y - other.y));
-}
\ No newline at end of file
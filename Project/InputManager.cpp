@@ -2,8 +2,44 @@
 
 #include <cstdio>
 
+#include "Profiler.h"
+
 InputManager* InputManager::instance_ = nullptr;
 
+namespace
+{
+   // Events are packed into one word so a slot can be read without tearing: type, code then timestamp
+   uint64_t PackEvent(const InputEvent::Type type, const short code, const Uint32 timestamp)
+   {
+      return (static_cast<uint64_t>(type) << 48) | (static_cast<uint64_t>(static_cast<Uint16>(code)) << 32) | timestamp;
+   }
+
+   InputEvent UnpackEvent(const uint64_t packed)
+   {
+      InputEvent event;
+      event.type = static_cast<InputEvent::Type>((packed >> 48) & 0xFF);
+      event.code = static_cast<short>(static_cast<Uint16>(packed >> 32));
+      event.timestamp = static_cast<Uint32>(packed);
+      return event;
+   }
+
+   // -1 for buttons we don't track
+   int ToMouseCode(const Uint8 button)
+   {
+      switch (button)
+      {
+      case SDL_BUTTON_LEFT:
+         return MouseLeft;
+      case SDL_BUTTON_RIGHT:
+         return MouseRight;
+      case SDL_BUTTON_MIDDLE:
+         return MouseMiddle;
+      default:
+         return -1;
+      }
+   }
+}
+
 InputManager::InputManager() = default;
 
 bool InputManager::IsValidKey(KeyCode& key_code)
@@ -23,20 +59,9 @@ InputManager* InputManager::Instance()
 
 void InputManager::Update()
 {
-   // We clear all our states
-   // Keyboard
-   for (int i = 0; i < keycode_max_value; i++)
-   {
-      is_key_down_[i] = false;
-      is_key_up_[i] = false;
-   }
-   //TODO Doesn't work?
-   // SDL_memset(is_key_down_, false, keycode_max_value * sizeof(bool));
-   // SDL_memset(is_key_up_, false, keycode_max_value * sizeof(bool));
-   //
-   // Mouse
-   SDL_memset(is_mouse_down_, false, MouseClickTypeCount * sizeof(bool));
-   SDL_memset(is_mouse_up_, false, MouseClickTypeCount * sizeof(bool));
+   PROFILE_SCOPE("InputManager::Update");
+   // Keys and buttons stamped with an older generation stop being down or up this frame
+   frame_generation_++;
 
    is_movement_down_ = false;
 
@@ -47,15 +72,28 @@ void InputManager::Update()
       switch (event.type)
       {
       case SDL_KEYDOWN:
+      {
          keyboard_ = SDL_GetKeyboardState(nullptr);
-         is_key_down_[event.key.keysym.scancode] = true;
-         is_key_held_[event.key.keysym.scancode] = true;
+         const int key = event.key.keysym.scancode;
+         if (key >= keycode_max_value)
+            break;
+         key_down_generation_[key] = frame_generation_;
+         is_key_held_.set(key);
+         key_press_count_[key].fetch_add(1, std::memory_order_release);
+         PushEvent(InputEvent::KeyDown, static_cast<short>(key), event.key.timestamp);
          break;
+      }
       case SDL_KEYUP:
+      {
          keyboard_ = SDL_GetKeyboardState(nullptr);
-         is_key_up_[event.key.keysym.scancode] = true;
-         is_key_held_[event.key.keysym.scancode] = false;
+         const int key = event.key.keysym.scancode;
+         if (key >= keycode_max_value)
+            break;
+         key_up_generation_[key] = frame_generation_;
+         is_key_held_.reset(key);
+         PushEvent(InputEvent::KeyUp, static_cast<short>(key), event.key.timestamp);
          break;
+      }
       case SDL_MOUSEMOTION:
          //TODO May need to remove the +1
          mouse_x_ = event.motion.x + 1;
@@ -64,24 +102,25 @@ void InputManager::Update()
          mouse_pos_ = IVec2(mouse_x_, mouse_y_);
          break;
       case SDL_MOUSEBUTTONDOWN:
+      {
          mouse_ = SDL_GetMouseState(&(mouse_x_), &(this->mouse_y_));
-         if (event.button.button == SDL_BUTTON_LEFT)
-            is_mouse_down_[MouseLeft] = true;
-         else if (event.button.button == SDL_BUTTON_RIGHT)
-            is_mouse_down_[MouseRight] = true;
-         else if (event.button.button == SDL_BUTTON_MIDDLE)
-            is_mouse_down_[MouseMiddle] = true;
+         const int button = ToMouseCode(event.button.button);
+         if (button < 0)
+            break;
+         mouse_down_generation_[button] = frame_generation_;
+         PushEvent(InputEvent::MouseDown, static_cast<short>(button), event.button.timestamp);
          break;
-
+      }
       case SDL_MOUSEBUTTONUP:
+      {
          mouse_ = SDL_GetMouseState(&(mouse_x_), &(this->mouse_y_));
-         if (event.button.button == SDL_BUTTON_LEFT)
-            is_mouse_up_[MouseLeft] = true;
-         else if (event.button.button == SDL_BUTTON_RIGHT)
-            is_mouse_up_[MouseRight] = true;
-         else if (event.button.button == SDL_BUTTON_MIDDLE)
-            is_mouse_up_[MouseMiddle] = true;
+         const int button = ToMouseCode(event.button.button);
+         if (button < 0)
+            break;
+         mouse_up_generation_[button] = frame_generation_;
+         PushEvent(InputEvent::MouseUp, static_cast<short>(button), event.button.timestamp);
          break;
+      }
 
       case SDL_MOUSEWHEEL:
          //TODO Does this work?
@@ -105,7 +144,7 @@ bool InputManager::IsMovementKeysDown()
       //TODO This could be improved, we can do this check during the Update, and then a final sweep after Inputs to check Helds.
       std::vector<int>::iterator it;
       for (it = movement_keys_.begin(); it != movement_keys_.end(); ++it) {
-         if (is_key_held_[(*it)] || is_key_down_[(*it)])
+         if (is_key_held_[(*it)] || key_down_generation_[(*it)] == frame_generation_)
          {
             is_movement_down_ = true;
             break;
@@ -119,14 +158,14 @@ auto InputManager::GetMouseDown(const short button) -> bool
 {
    if (button < 0 || button >= MouseClickTypeCount)
       return false;
-   return (is_mouse_down_[button]);
+   return (mouse_down_generation_[button] == frame_generation_);
 }
 
 bool InputManager::GetMouseUp(const short button)
 {
    if (button < 0 || button >= MouseClickTypeCount)
       return false;
-   return (is_mouse_up_[button]);
+   return (mouse_up_generation_[button] == frame_generation_);
 }
 
 bool InputManager::GetMouseButton(const short button) const
@@ -162,14 +201,14 @@ bool InputManager::GetKeyDown(KeyCode key_code)
 {
    if (!IsValidKey(key_code))
       return false;
-   return (is_key_down_[static_cast<int>(key_code)]);
+   return (key_down_generation_[static_cast<int>(key_code)] == frame_generation_);
 }
 
 bool InputManager::GetKeyUp(KeyCode key_code)
 {
    if (!IsValidKey(key_code))
       return false;
-   return (is_key_up_[static_cast<int>(key_code)]);
+   return (key_up_generation_[static_cast<int>(key_code)] == frame_generation_);
 }
 
 bool InputManager::GetKeyButton(KeyCode key_code) const
@@ -180,3 +219,65 @@ bool InputManager::GetKeyButton(KeyCode key_code) const
       return true;
    return false;
 }
+
+bool InputManager::ConsumeKeyPress(KeyCode key_code)
+{
+   if (!IsValidKey(key_code))
+      return false;
+   const int key = static_cast<int>(key_code);
+   if (key_press_consumed_[key] == key_press_count_[key].load(std::memory_order_acquire))
+      return false;
+   key_press_consumed_[key]++;
+   return true;
+}
+
+InputEventCursor InputManager::CreateEventCursor() const
+{
+   InputEventCursor cursor;
+   cursor.next = events_written_.load(std::memory_order_acquire);
+   return cursor;
+}
+
+/// <summary>
+/// Copies the cursor's next event into out. A cursor that has fallen more than input_event_capacity events behind
+/// skips ahead to the oldest event still in the ring, counting what it missed in cursor.dropped.
+/// </summary>
+bool InputManager::PollEvent(InputEventCursor& cursor, InputEvent& out) const
+{
+   while (true)
+   {
+      const uint64_t written = events_written_.load(std::memory_order_acquire);
+      if (cursor.next >= written)
+         return false;
+      if (written - cursor.next > input_event_capacity)
+      {
+         cursor.dropped += written - input_event_capacity - cursor.next;
+         cursor.next = written - input_event_capacity;
+      }
+
+      const EventSlot& slot = events_[cursor.next % input_event_capacity];
+      const uint64_t sequenceBefore = slot.sequence.load(std::memory_order_acquire);
+      const uint64_t packed = slot.packed.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint64_t sequenceAfter = slot.sequence.load(std::memory_order_relaxed);
+      if (sequenceBefore == cursor.next + 1 && sequenceAfter == sequenceBefore)
+      {
+         out = UnpackEvent(packed);
+         cursor.next++;
+         return true;
+      }
+      // Update lapped us mid read, go round again and skip past what it overwrote
+   }
+}
+
+void InputManager::PushEvent(const InputEvent::Type type, const short code, const Uint32 timestamp)
+{
+   const uint64_t index = events_written_.load(std::memory_order_relaxed);
+   EventSlot& slot = events_[index % input_event_capacity];
+   // Readers treat a sequence of 0 as mid write
+   slot.sequence.store(0, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+   slot.packed.store(PackEvent(type, code, timestamp), std::memory_order_relaxed);
+   slot.sequence.store(index + 1, std::memory_order_release);
+   events_written_.store(index + 1, std::memory_order_release);
+}
\ No newline at end of file
@@ -2,15 +2,41 @@
 #include "SDL.h"
 #include "Math.h"
 #include <backends/imgui_impl_sdl.h>
+#include <atomic>
+#include <bitset>
 #include <vector>
 
 
 #include "InputKeyCodes.h"
-//TODO Implement an event system? Would be nice to call events from here
+
+/// <summary> A single key or mouse button change, stamped with the time SDL received it. </summary>
+struct InputEvent
+{
+   enum Type : Uint8 { KeyDown, KeyUp, MouseDown, MouseUp };
+
+   Type type;
+   // KeyCode for key events, MouseCode for mouse events
+   short code;
+   // SDL_GetTicks() time of the OS event, not when Update got to it
+   Uint32 timestamp;
+
+   bool IsKeyDown(KeyCode key_code) const { return type == KeyDown && code == static_cast<short>(key_code); }
+};
+
+/// <summary> A consumer's place in the input event ring, each consumer keeps its own so they all see every event. </summary>
+struct InputEventCursor
+{
+   uint64_t next = 0;
+   // Events overwritten before this consumer got to them
+   uint64_t dropped = 0;
+};
 
 class InputManager
 {
 public:
+   // Events kept for consumers that fall behind, a consumer more than this many events behind loses the oldest
+   static constexpr int input_event_capacity = 256;
+
    static InputManager* Instance();
 
    void Update();
@@ -35,6 +61,15 @@ public:
    // State of key (Down/Up)
    bool GetKeyButton(KeyCode key_code) const;
 
+   // Thread safe, for use from the simulation thread. Returns true once for every press of the key since it was last consumed.
+   bool ConsumeKeyPress(KeyCode key_code);
+
+   // Event ring
+   // A cursor that starts with the next event, so a new consumer doesn't see old input
+   InputEventCursor CreateEventCursor() const;
+   // Thread safe, any number of consumers can drain their own cursor alongside Update. Returns false once the cursor has caught up.
+   bool PollEvent(InputEventCursor& cursor, InputEvent& out) const;
+
    // Helper Methods
    int MouseX() const { return mouse_x_; }
    int MouseY() const { return mouse_y_; }
@@ -61,13 +96,32 @@ private:
 
    bool is_movement_down_ = false;
 
-   bool is_key_held_[keycode_max_value]{ false };
-
-   bool is_key_down_[keycode_max_value]{ false };
-   bool is_key_up_[keycode_max_value]{ false };
+   // Down and up are "this frame" states, a key is down this frame if its stamp matches frame_generation_.
+   // Update only has to bump the generation to clear them all, instead of touching every key.
+   Uint32 frame_generation_ = 1;
+   std::bitset<keycode_max_value> is_key_held_;
+   Uint32 key_down_generation_[keycode_max_value]{ 0 };
+   Uint32 key_up_generation_[keycode_max_value]{ 0 };
+
+   // Written by Update, read by ConsumeKeyPress on the simulation thread
+   std::atomic<Uint32> key_press_count_[keycode_max_value]{};
+   // Only touched by ConsumeKeyPress
+   Uint32 key_press_consumed_[keycode_max_value]{ 0 };
+
+   Uint32 mouse_down_generation_[MouseClickTypeCount]{ 0 };
+   Uint32 mouse_up_generation_[MouseClickTypeCount]{ 0 };
+
+   // Single writer (Update) ring of events. Each slot is a seqlock, the event is packed into one word and its sequence is
+   // event index + 1 once written, so a reader can tell an event it is still waiting for from one that has been overwritten.
+   struct EventSlot
+   {
+      std::atomic<uint64_t> sequence{ 0 };
+      std::atomic<uint64_t> packed{ 0 };
+   };
+   EventSlot events_[input_event_capacity];
+   std::atomic<uint64_t> events_written_{ 0 };
 
-   bool is_mouse_down_[MouseClickTypeCount]{ false };
-   bool is_mouse_up_[MouseClickTypeCount]{ false };
+   void PushEvent(InputEvent::Type type, short code, Uint32 timestamp);
 
    std::vector<int> movement_keys_ = {
       static_cast<int>(KeyCode::W),
@@ -0,0 +1,33 @@
+#include "LatencyTracker.h"
+
+#include <algorithm>
+
+void LatencyTracker::AddSample(const float milliseconds)
+{
+   history_[history_index_] = milliseconds;
+   history_index_ = (history_index_ + 1) % history_size;
+   if (history_count_ < history_size)
+      history_count_++;
+   total_samples_++;
+}
+
+LatencyTracker::Stats LatencyTracker::GetStats() const
+{
+   Stats stats;
+   stats.samples = total_samples_;
+   if (history_count_ == 0)
+      return stats;
+
+   float sorted[history_size];
+   std::copy(history_, history_ + history_count_, sorted);
+   std::sort(sorted, sorted + history_count_);
+   const auto percentile = [&](const float fraction)
+   {
+      return sorted[std::min(history_count_ - 1, static_cast<int>(fraction * history_count_))];
+   };
+   stats.p50 = percentile(0.5f);
+   stats.p95 = percentile(0.95f);
+   stats.p99 = percentile(0.99f);
+   stats.max = sorted[history_count_ - 1];
+   return stats;
+}
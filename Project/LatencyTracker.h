@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+
+/// <summary>
+/// Keeps the most recent latency samples (ms) and works out percentiles over them, like FramePacer does for frame times.
+/// Not thread safe, samples are added and read on the render thread.
+/// </summary>
+class LatencyTracker
+{
+public:
+   static constexpr int history_size = 240;
+
+   struct Stats
+   {
+      float p50 = 0.0f;
+      float p95 = 0.0f;
+      float p99 = 0.0f;
+      float max = 0.0f;
+      // Every sample since startup, not just the ones still in the history
+      uint64_t samples = 0;
+   };
+
+   void AddSample(float milliseconds);
+
+   Stats GetStats() const;
+   // Sample times (ms) oldest first from GetHistoryOffset, for plotting
+   const float* GetHistory() const { return history_; }
+   int GetHistoryOffset() const { return history_index_; }
+
+private:
+   float history_[history_size]{ 0.0f };
+   int history_index_ = 0;
+   int history_count_ = 0;
+   uint64_t total_samples_ = 0;
+};
@@ -0,0 +1,101 @@
+#include "MappedFile.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+   Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path)
+{
+   Close();
+   file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (file_ == INVALID_HANDLE_VALUE)
+   {
+      file_ = nullptr;
+      printf("Failed to open %s\n", path.c_str());
+      return false;
+   }
+
+   LARGE_INTEGER fileSize;
+   GetFileSizeEx(file_, &fileSize);
+   size_ = static_cast<size_t>(fileSize.QuadPart);
+   if (size_ == 0)
+      return true;
+
+   mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (mapping_)
+      data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+   if (!data_)
+   {
+      printf("Failed to map %s\n", path.c_str());
+      Close();
+      return false;
+   }
+   return true;
+}
+
+void MappedFile::Close()
+{
+   if (data_)
+      UnmapViewOfFile(data_);
+   if (mapping_)
+      CloseHandle(mapping_);
+   if (file_)
+      CloseHandle(file_);
+   data_ = nullptr;
+   mapping_ = nullptr;
+   file_ = nullptr;
+   size_ = 0;
+}
+#else
+bool MappedFile::Open(const std::string& path)
+{
+   Close();
+   file_ = open(path.c_str(), O_RDONLY);
+   if (file_ == -1)
+   {
+      printf("Failed to open %s\n", path.c_str());
+      return false;
+   }
+
+   struct stat fileStat {};
+   fstat(file_, &fileStat);
+   size_ = static_cast<size_t>(fileStat.st_size);
+   if (size_ == 0)
+      return true;
+
+   void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+   if (mapped == MAP_FAILED)
+   {
+      printf("Failed to map %s\n", path.c_str());
+      Close();
+      return false;
+   }
+   data_ = static_cast<const uint8_t*>(mapped);
+   return true;
+}
+
+void MappedFile::Close()
+{
+   if (data_)
+      munmap(const_cast<uint8_t*>(data_), size_);
+   if (file_ != -1)
+      close(file_);
+   data_ = nullptr;
+   file_ = -1;
+   size_ = 0;
+}
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// Read only memory mapped file, large files are paged in by the OS as they are read rather than loaded up front.
+/// </summary>
+class MappedFile
+{
+public:
+   MappedFile() = default;
+   ~MappedFile();
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+   bool Open(const std::string& path);
+   void Close();
+
+   const uint8_t* Data() const { return data_; }
+   size_t Size() const { return size_; }
+
+private:
+   const uint8_t* data_ = nullptr;
+   size_t size_ = 0;
+
+#ifdef _WIN32
+   void* file_ = nullptr;
+   void* mapping_ = nullptr;
+#else
+   int file_ = -1;
+#endif
+};
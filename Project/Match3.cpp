@@ -1,46 +1,62 @@
 #include "Match3.h"
-#include "FloatExtensions.h"
-#include "InputManager.h"
 
-Match3::Match3(GameSettings* settings)
-{
-   game_settings = settings;
+#include <chrono>
+#include <cstring>
 
-   srand(time(0));
-
-   coloured_textures_ = new GLuint[CELL_TYPE_COUNT];
+#include "EngineCounters.h"
+#include "FloatExtensions.h"
+#include "Profiler.h"
+#include "Replay.h"
 
-   // Textures for our blocks.
-   glGenTextures(CELL_TYPE_COUNT, coloured_textures_);
-   for (int i = 0; i < CELL_TYPE_COUNT; i++)
+namespace
+{
+   // Adds the legal move search's counters once, whichever return it leaves through
+   struct LegalMoveSearchCounters
    {
-      glBindTexture(GL_TEXTURE_2D, coloured_textures_[i]);
-
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, cell_texture_size, cell_texture_size, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8,
-                   &g_cell_colours[i]);
-   }
+      // Searches picking a move for the AI count their candidates as AI nodes, the engine's own no-moves check doesn't
+      LegalMoveSearchCounters(const bool is_counted, const bool is_ai_move) : is_counted(is_counted), is_ai_move(is_ai_move)
+      {
+         if (is_counted)
+            start = std::chrono::steady_clock::now();
+      }
 
-   glUseProgram(game_settings->default_shader);
-   glUniform1i(glGetUniformLocation(game_settings->default_shader, "ourTexture"), 0);
+      const bool is_counted;
+      const bool is_ai_move;
+      uint64_t cells_scanned = 0;
+      uint64_t candidates = 0;
+      std::chrono::steady_clock::time_point start;
 
-   glGenVertexArrays(1, &vao_);
-   glGenBuffers(1, &vbo_);
-   glGenBuffers(1, &ebo_);
+      ~LegalMoveSearchCounters()
+      {
+         if (!is_counted)
+            return;
+         const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+         EngineCounters::Add(EngineCounter::LegalMoveSearches);
+         EngineCounters::Add(EngineCounter::LegalMoveSearchNanoseconds, static_cast<uint64_t>(elapsed.count()));
+         EngineCounters::Add(EngineCounter::CellsScanned, cells_scanned);
+         if (is_ai_move)
+            EngineCounters::Add(EngineCounter::AiNodes, candidates);
+      }
+   };
+}
 
-   glBindVertexArray(vao_);
+Match3::Match3(GameSettings* settings)
+{
+   game_settings = settings;
 
-   glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+   seed_ = (settings->random_seed != 0 ? settings->random_seed : static_cast<uint32_t>(time(0)));
+   random_.Seed(seed_);
+}
 
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+void Match3::Reseed(const Uint32 seed)
+{
+   seed_ = seed;
+   random_.Seed(seed_);
+}
 
-   // position attribute
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-   glEnableVertexAttribArray(0);
-   // texture coord attribute
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-   glEnableVertexAttribArray(1);
+Match3::~Match3()
+{
+   delete[] world_data_;
 }
 
 const GameRules* Match3::GetRules() const
@@ -78,9 +94,9 @@ bool Match3::GeneratePlayField(Uint32 width, Uint32 height, Uint32 numTypes)
    game_rules_.world_size_total = width * height;
    game_rules_.cell_types_used = numTypes;
 
-   if (world_data_ == nullptr) {
-      world_data_ = new int[game_rules_.world_size_total]{0};
-   }
+   if (world_data_ == nullptr)
+      AllocateWorldData();
+   MarkAllCellsChanged();
 
    // Clear all tiles
    no_valid_moves_ = false;
@@ -89,6 +105,81 @@ bool Match3::GeneratePlayField(Uint32 width, Uint32 height, Uint32 numTypes)
    return true;
 }
 
+void Match3::AllocateWorldData()
+{
+   world_data_ = new int[game_rules_.world_size_total]{0};
+   is_cell_changed_.assign(game_rules_.world_size_total, false);
+   changed_cells_.reserve(game_rules_.world_size_total);
+   // Each cell adds at most 3 entries, reserved so ClearMatches never has to grow it mid-game
+   world_clear_array_.reserve(static_cast<size_t>(game_rules_.world_size_total) * 3);
+}
+
+size_t Match3::GetSnapshotSize() const
+{
+   return sizeof(Match3State) + sizeof(int) * game_rules_.world_size_total;
+}
+
+void Match3::Snapshot(void* out) const
+{
+   Match3State state;
+   state.rules = game_rules_;
+   state.tick = tick_;
+   state.random_state = random_.state;
+   state.world_update_rate = world_update_rate_;
+   state.world_update_cooldown_x = world_update_cooldown_x_;
+   state.flags = (is_ready_for_move_ ? Match3State::ReadyForMove : 0) | (no_valid_moves_ ? Match3State::NoValidMoves : 0) |
+                 (g_extraInfo.next_frame_restarts ? Match3State::NextFrameRestarts : 0) | (is_cascading_ ? Match3State::Cascading : 0);
+   state.game_score = g_extraInfo.game_score;
+   state.game_high_score = g_extraInfo.game_high_score;
+   state.moves_since_last_reset = g_extraInfo.moves_since_last_reset;
+   state.cascade_depth = cascade_depth_;
+
+   memcpy(out, &state, sizeof(Match3State));
+   memcpy(static_cast<uint8_t*>(out) + sizeof(Match3State), world_data_, sizeof(int) * game_rules_.world_size_total);
+}
+
+bool Match3::Restore(const void* snapshot)
+{
+   Match3State state;
+   memcpy(&state, snapshot, sizeof(Match3State));
+   if (world_data_ == nullptr)
+   {
+      // Nothing generated yet, the snapshot decides the board size
+      game_rules_ = state.rules;
+      AllocateWorldData();
+   }
+   else if (state.rules.world_width != game_rules_.world_width || state.rules.world_height != game_rules_.world_height)
+      return false;
+
+   game_rules_.cell_types_used = state.rules.cell_types_used;
+   tick_ = state.tick;
+   random_.state = state.random_state;
+   world_update_rate_ = state.world_update_rate;
+   world_update_cooldown_x_ = state.world_update_cooldown_x;
+   is_ready_for_move_ = (state.flags & Match3State::ReadyForMove) != 0;
+   no_valid_moves_ = (state.flags & Match3State::NoValidMoves) != 0;
+   g_extraInfo.next_frame_restarts = (state.flags & Match3State::NextFrameRestarts) != 0;
+   is_cascading_ = (state.flags & Match3State::Cascading) != 0;
+   g_extraInfo.game_score = state.game_score;
+   g_extraInfo.game_high_score = state.game_high_score;
+   g_extraInfo.moves_since_last_reset = state.moves_since_last_reset;
+   cascade_depth_ = state.cascade_depth;
+
+   memcpy(world_data_, static_cast<const uint8_t*>(snapshot) + sizeof(Match3State), sizeof(int) * game_rules_.world_size_total);
+   MarkAllCellsChanged();
+   external_change_count_++;
+   return true;
+}
+
+bool Match3::HasSameBoard(const void* snapshot) const
+{
+   Match3State state;
+   memcpy(&state, snapshot, sizeof(Match3State));
+   if (state.rules.world_width != game_rules_.world_width || state.rules.world_height != game_rules_.world_height || state.random_state != random_.state)
+      return false;
+   return memcmp(world_data_, static_cast<const uint8_t*>(snapshot) + sizeof(Match3State), sizeof(int) * game_rules_.world_size_total) == 0;
+}
+
 bool Match3::IsReadyForMove() const
 {
    return is_ready_for_move_;
@@ -96,11 +187,17 @@ bool Match3::IsReadyForMove() const
 
 bool Match3::Step(const IVec2 from_cell, const IVec2 to_cell)
 {
+   // Both cells have to be on the board, a move off it is ignored before it touches anything, so it is never recorded either.
+   // ApplyCommand is the only way moves get in, this covers the player, replays, the monitor grid and the session server alike.
+   if (!IsValidCell(from_cell.x, from_cell.y) || !IsValidCell(to_cell.x, to_cell.y))
+      return false;
+
+   // Every other call is recorded, even rejected moves reset the cooldown
+   if (recorder_)
+      recorder_->RecordMove(tick_, from_cell, to_cell);
+   external_change_count_++;
    world_update_cooldown_x_ = world_update_rate_ * 2.0f;
    g_extraInfo.ClearMovedCells();
-   // Check cells being passed in are valid cells
-   if (!(IsValidCell(from_cell.x, from_cell.y) || IsValidCell(to_cell.x, to_cell.y)))
-      return false;
 
    // We only want to move 1 square, anything other than 1 should be an invalid move
    if (!FloatsEqual(IVec2::Distance(from_cell, to_cell), 1.0f))
@@ -113,12 +210,20 @@ bool Match3::Step(const IVec2 from_cell, const IVec2 to_cell)
    {
       is_ready_for_move_ = false;
       g_extraInfo.moves_since_last_reset++;
+      AddCounter(EngineCounter::Moves);
+      // Cascades are only tracked for moves actually played
+      if (!is_search_board)
+      {
+         cascade_depth_ = 0;
+         is_cascading_ = true;
+      }
 
       if (g_print_ai_moves)
          PrintWorldAsText();
       return true;
    }
    SwapCellValues(from_cell, to_cell);
+   AddCounter(EngineCounter::RejectedMoves);
    return false;
 }
 
@@ -127,10 +232,16 @@ bool Match3::Step(const IVec2 from_cell, const IVec2 to_cell)
 /// </summary>
 void Match3::ProgressGame()
 {
-   // We try to move the cells down
-   if (!StepCellsDown() && !ClearMatches())
+   PROFILE_SCOPE("Match3::ProgressGame");
+   // We try to move the cells down, the board is only settled once nothing falls and the top row is full again
+   if (!StepCellsDown() && IsRowFull(0) && !ClearMatches())
    {
       is_ready_for_move_ = true;
+      if (is_cascading_)
+      {
+         MaxCounter(EngineCounter::MaxCascadeDepth, cascade_depth_);
+         is_cascading_ = false;
+      }
       // Check for legal moves and return the first one found
       if (!AnyLegalMatchesExist())
       {
@@ -157,19 +268,30 @@ void Match3::ProgressGame()
 /// <returns>Returns true if any changes are made</returns>
 bool Match3::StepCellsDown()
 {
+   PROFILE_SCOPE("Match3::StepCellsDown");
    bool isChanged = false;
-   for (int y = game_rules_.world_height - 1; y >= 0; y--)
+   uint64_t cellsFallen = 0;
+   // Bottom row has nothing below it, so start one above
+   for (int y = game_rules_.world_height - 2; y >= 0; y--)
    {
       for (int x = 0; x < game_rules_.world_width; x++)
       {
          if (world_data_[GetCellIndex(x, y)] != EMPTY && world_data_[GetCellIndex(x, y + 1)] == EMPTY)
          {
-            world_data_[GetCellIndex(x, y + 1)] = world_data_[GetCellIndex(x, y)];
-            world_data_[GetCellIndex(x, y)] = EMPTY;
+            SetCell(GetCellIndex(x, y + 1), world_data_[GetCellIndex(x, y)]);
+            SetCell(GetCellIndex(x, y), EMPTY);
             isChanged = true;
+            cellsFallen++;
          }
       }
    }
+
+   AddCounter(EngineCounter::CellsScanned, static_cast<uint64_t>(game_rules_.world_width) * (game_rules_.world_height - 1));
+   if (isChanged)
+   {
+      AddCounter(EngineCounter::GravitySteps);
+      AddCounter(EngineCounter::CellsFallen, cellsFallen);
+   }
    return isChanged;
 }
 
@@ -177,18 +299,35 @@ bool Match3::StepCellsDown()
 /// <returns>True if any changes are made</returns>
 bool Match3::CreateCellsMissingInRow(int row = 0)
 {
+   PROFILE_SCOPE("Match3::CreateCellsMissingInRow");
    bool isChanged = false;
+   uint64_t refilled = 0;
    for (int x = 0; x < game_rules_.world_width; x++)
    {
       if (world_data_[GetCellIndex(x, row)] == EMPTY)
       {
-         world_data_[GetCellIndex(x, row)] = GetNewRandomCell();
+         SetCell(GetCellIndex(x, row), GetNewRandomCell());
          isChanged = true;
+         refilled++;
       }
    }
+
+   AddCounter(EngineCounter::CellsScanned, game_rules_.world_width);
+   AddCounter(EngineCounter::RefillCells, refilled);
    return isChanged;
 }
 
+/// <summary> Checks a row has no EMPTY cells, once nothing is falling a full top row means the whole board is full </summary>
+bool Match3::IsRowFull(const int row) const
+{
+   for (int x = 0; x < game_rules_.world_width; x++)
+   {
+      if (world_data_[GetCellIndex(x, row)] == EMPTY)
+         return false;
+   }
+   return true;
+}
+
 /// <summary> Sets all cells to the type passed in, if RANDOM is passed in, all cells are set to a random type </summary>
 void Match3::SetWorldCells(CellTypes type)
 {
@@ -196,7 +335,7 @@ void Match3::SetWorldCells(CellTypes type)
    {
       for (int x = 0; x < game_rules_.world_width; x++)
       {
-         world_data_[GetCellIndex(x, y)] = (type == RANDOM ? GetNewRandomCell() : type);
+         SetCell(GetCellIndex(x, y), (type == RANDOM ? GetNewRandomCell() : type));
       }
    }
 }
@@ -206,9 +345,12 @@ void Match3::SetWorldCells(CellTypes type)
 /// </summary>
 void Match3::ResetWorld()
 {
+   PROFILE_SCOPE("Match3::ResetWorld");
    // Reset GUI Info
    g_extraInfo.Clear();
    no_valid_moves_ = false;
+   // Nothing can be played until the board has refilled
+   is_ready_for_move_ = false;
    SetWorldCells(EMPTY);
 }
 
@@ -217,12 +359,16 @@ void Match3::ResetWorld()
 /// Note: This also has a huge bias towards Vertical moves.</summary>
 bool Match3::AnyLegalMatchesExist(IVec2 move[])
 {
+   PROFILE_SCOPE("Match3::AnyLegalMatchesExist");
+   // Only callers after a move are picking one to play, the no-moves check just wants to know there is one
+   LegalMoveSearchCounters counters(!is_search_board, move != nullptr);
    // Check for valid moves
    // Vertical Moves
    for (int y = 0; y < game_rules_.world_height; y++)
    {
       for (int x = 0; x < game_rules_.world_width; x++)
       {
+         counters.cells_scanned++;
          // Check A and C
          if (!IsValidCell(x - 1, y) || !IsValidCell(x + 1, y))
             continue;
@@ -235,6 +381,7 @@ bool Match3::AnyLegalMatchesExist(IVec2 move[])
          // Moving Down from Above
          if (IsValidCell(x, y - 1))
          {
+            counters.candidates++;
             const int movingCellsIndex = GetCellIndex(x, y - 1);
             if (
                IsMatch(cellA, movingCellsIndex, cellC) ||
@@ -251,6 +398,7 @@ bool Match3::AnyLegalMatchesExist(IVec2 move[])
          // Middle from Bottom
          if (IsValidCell(x, y + 1))
          {
+            counters.candidates++;
             const int movingCellsIndex = GetCellIndex(x, y + 1);
             if (
                IsMatch(cellA, movingCellsIndex, cellC) || // Middle
@@ -271,6 +419,7 @@ bool Match3::AnyLegalMatchesExist(IVec2 move[])
    {
       for (int x = 0; x < game_rules_.world_width; x++)
       {
+         counters.cells_scanned++;
          // Check A and C
          if (!IsValidCell(x, y - 1) || !IsValidCell(x, y + 1))
             continue;
@@ -282,6 +431,8 @@ bool Match3::AnyLegalMatchesExist(IVec2 move[])
 
          if (IsValidCell(x - 1, y))
          {
+
+            counters.candidates++;
             const int movingCellsIndex = GetCellIndex(x - 1, y);
             if (
                IsMatch(cellA, movingCellsIndex, cellC) ||
@@ -298,6 +449,8 @@ bool Match3::AnyLegalMatchesExist(IVec2 move[])
 
          if (IsValidCell(x + 1, y))
          {
+
+            counters.candidates++;
             const int movingCellsIndex = GetCellIndex(x + 1, y);
             if (IsMatch(cellA, GetCellIndex(x + 1, y), cellC) ||
                IsValidCell(x, y - 2) && IsMatch(GetCellIndex(x, y - 2), movingCellsIndex, cellA) ||
@@ -317,6 +470,9 @@ bool Match3::AnyLegalMatchesExist(IVec2 move[])
 
 bool Match3::IsMatch(int cell_a, int cell_b, int cell_c)
 {
+   // Gaps left by a reset or a clear aren't cells, three of them in a row is not a match
+   if (world_data_[cell_a] == EMPTY)
+      return false;
    return (world_data_[cell_a] == world_data_[cell_b] && world_data_[cell_a] == world_data_[cell_c]);
 }
 
@@ -330,12 +486,16 @@ bool Match3::IsValidCell(const int x, const int y) const
 /// <returns>True if any cells are changed</returns>
 bool Match3::ClearMatches()
 {
+   PROFILE_SCOPE("Match3::ClearMatches");
    bool isChanged = false;
+   uint64_t matchesFound = 0;
    for (int y = 0; y < game_rules_.world_height; y++)
    {
       for (int x = 0; x < game_rules_.world_width; x++)
       {
          const short result = CheckMatches(x, y);
+         if (result != MatchType::NO_MATCH)
+            matchesFound++;
          if (result == MatchType::VERTICAL)
          {
             world_clear_array_.push_back(GetCellIndex(x, y));
@@ -351,19 +511,33 @@ bool Match3::ClearMatches()
       }
    }
 
+   const uint64_t cellCount = static_cast<uint64_t>(game_rules_.world_width) * game_rules_.world_height;
+   AddCounter(EngineCounter::CellsScanned, cellCount);
+   AddCounter(EngineCounter::MatchChecks, cellCount);
+   AddCounter(EngineCounter::MatchesFound, matchesFound);
+
    if (!world_clear_array_.empty()) {
       isChanged = true;
       g_extraInfo.ClearMovedCells();
+      uint64_t cellsCleared = 0;
       for (auto index : world_clear_array_)
       {
          // Lazy tracking, we will have duplicates
          if (world_data_[index] != EMPTY) {
-            world_data_[index] = EMPTY;
+            SetCell(index, EMPTY);
             // Lazy score, we just add all the cells we remove.
             g_extraInfo.AddPoint();
+            cellsCleared++;
          }
       }
       world_clear_array_.clear();
+      AddCounter(EngineCounter::CellsCleared, cellsCleared);
+
+      if (is_cascading_)
+      {
+         cascade_depth_++;
+         AddCounter(EngineCounter::CascadeRounds);
+      }
    }
    return isChanged;
 }
@@ -376,16 +550,22 @@ bool Match3::ClearMatches()
 /// <returns>True if any matches are discovered</returns>
 bool Match3::CheckForMatches()
 {
+   uint64_t checked = 0;
    for (int y = 0; y < game_rules_.world_height; y++)
    {
       for (int x = 0; x < game_rules_.world_width; x++)
       {
+         checked++;
          if (CheckMatches(x, y))
          {
+            AddCounter(EngineCounter::CellsScanned, checked);
+            AddCounter(EngineCounter::MatchChecks, checked);
             return true;
          }
       }
    }
+   AddCounter(EngineCounter::CellsScanned, checked);
+   AddCounter(EngineCounter::MatchChecks, checked);
    return false;
 }
 
@@ -411,58 +591,46 @@ void Match3::Start()
    PrintWorldAsText();
 }
 
-bool Match3::Draw(Camera* camera)
+void Match3::ApplyCommand(const Command& command)
 {
-   const IVec2 screenSize = game_settings->screen_size;
-
-   const int cellSpacing = 32;
-   const int cellExtraSpace = 16;
-
-   const IVec2 movedFrom = g_extraInfo.last_cell_moved_from;
-   const IVec2 movedTo = g_extraInfo.last_cell_moved_to;
-
-   // All use same shader
-   glUseProgram(game_settings->default_shader);
-   for (int y = 0; y < game_rules_.world_height; y++)
+   switch (command.type)
    {
-      for (int x = 0; x < game_rules_.world_width; x++)
-      {
-         glActiveTexture(GL_TEXTURE0);
-         glBindTexture(GL_TEXTURE_2D, coloured_textures_[world_data_[GetCellIndex(x, y)]]);
-
-         glm::mat4 model = glm::mat4(1.0f);
-         //TODO Fix this
-         glm::vec3 modelPosition = glm::vec3(cellExtraSpace + (cell_screen_size / 2) + ((cell_screen_size + cellSpacing) * x), screenSize.y - (cellExtraSpace + (cell_screen_size / 2) + ((cell_screen_size + cellSpacing) * y)), 1.0f);
-         model = glm::translate(model, modelPosition);
-
-         const float movedScaleMultiplier = ((x == movedFrom.x && y == movedFrom.y) || (x == movedTo.x && y == movedTo.y)) ? 1.5f : 1.0f;
-
-         model = glm::scale(model, glm::vec3(cell_screen_size * movedScaleMultiplier, cell_screen_size * movedScaleMultiplier, 1.0f));
-
-         const int modelLoc = glGetUniformLocation(game_settings->default_shader, "model");
-         glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-         const int projLoc = glGetUniformLocation(game_settings->default_shader, "projection");
-         glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(camera->GetProjection()));
-
-         glBindVertexArray(vao_);
-         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-      }
+   case Command::Swap:
+      Step(command.from, command.to);
+      break;
+   case Command::Reset:
+      if (recorder_)
+         recorder_->RecordReset(tick_);
+      external_change_count_++;
+      ResetWorld();
+      break;
+   case Command::SetUpdateRate:
+   case Command::ToggleUpdateRate:
+      world_update_rate_ = (command.type == Command::SetUpdateRate ? command.value : (world_update_rate_ == 250 ? 50 : 250));
+      if (recorder_)
+         recorder_->RecordUpdateRate(tick_, world_update_rate_);
+      break;
+   case Command::PrintBoard:
+      PrintWorldAsText();
+      break;
+   case Command::ToggleAiLog:
+      g_print_ai_moves = !g_print_ai_moves;
+      break;
    }
-
-   return true;
 }
 
-void Match3::Update(const double delta)
+void Match3::FixedUpdate()
 {
-   world_update_cooldown_x_ -= delta;
+   PROFILE_SCOPE("Match3::FixedUpdate");
+   if (recorder_)
+      recorder_->OnFixedUpdate(*this);
+   tick_++;
+   world_update_cooldown_x_ -= game_settings->fixed_update_time;
    if (0.0 > world_update_cooldown_x_) {
       world_update_cooldown_x_ = world_update_rate_;
       ProgressGame();
    }
 
-   if (InputManager::Instance()->GetKeyDown(KeyCode::Space))
-      world_update_rate_ = (world_update_rate_ == 250 ? 50 : 250);
-
    // Update GUI Info
    g_extraInfo.world_step_cooldown = world_update_cooldown_x_;
 }
@@ -471,16 +639,65 @@ void Match3::Update(const double delta)
 void Match3::SwapCellValues(IVec2 from_cell, IVec2 to_cell)
 {
    const int temp = world_data_[GetCellIndex(from_cell.x, from_cell.y)];
-   world_data_[GetCellIndex(from_cell.x, from_cell.y)] = world_data_[GetCellIndex(to_cell.x, to_cell.y)];
-   world_data_[GetCellIndex(to_cell.x, to_cell.y)] = temp;
+   SetCell(GetCellIndex(from_cell.x, from_cell.y), world_data_[GetCellIndex(to_cell.x, to_cell.y)]);
+   SetCell(GetCellIndex(to_cell.x, to_cell.y), temp);
 
    // GUI Info
    g_extraInfo.last_cell_moved_from = from_cell;
    g_extraInfo.last_cell_moved_to = to_cell;
 }
 
+// Search boards play out moves that never happen, counting them would swamp the real game's counters
+void Match3::AddCounter(const EngineCounter counter, const uint64_t amount) const
+{
+   if (!is_search_board)
+      EngineCounters::Add(counter, amount);
+}
+
+void Match3::MaxCounter(const EngineCounter counter, const uint64_t amount) const
+{
+   if (!is_search_board)
+      EngineCounters::Max(counter, amount);
+}
+
+/// <summary> Sets the value of a cell, recording the change for the renderer if the value is different. </summary>
+void Match3::SetCell(const int index, const int type)
+{
+   if (world_data_[index] == type)
+      return;
+   world_data_[index] = type;
+   board_version_++;
+   if (!is_cell_changed_[index])
+   {
+      is_cell_changed_[index] = true;
+      changed_cells_.push_back(index);
+   }
+}
+
+// Flags every cell as changed, used when the whole board needs to be re-uploaded
+void Match3::MarkAllCellsChanged()
+{
+   board_version_++;
+   // Already all flagged, so restoring snapshot after snapshot doesn't rebuild the list every time
+   if (changed_cells_.size() == static_cast<size_t>(game_rules_.world_size_total))
+      return;
+   changed_cells_.clear();
+   for (int i = 0; i < game_rules_.world_size_total; i++)
+   {
+      is_cell_changed_[i] = true;
+      changed_cells_.push_back(i);
+   }
+}
+
+void Match3::ClearChangedCells()
+{
+   for (auto index : changed_cells_)
+      is_cell_changed_[index] = false;
+   changed_cells_.clear();
+}
+
 // Returns a value between 1 and the cell_types_used (inclusive)
-int Match3::GetNewRandomCell() const
+int Match3::GetNewRandomCell()
 {
-   return InclusiveRandom(1, game_rules_.cell_types_used);
+   return random_.Range(1, game_rules_.cell_types_used);
 }
@@ -1,19 +1,55 @@
 #pragma once
 #include <cstdio>
 #include <SDL_stdinc.h>
-#include <GL/glew.h>
+#include <type_traits>
+#include <vector>
 
 
 #include "CellTypes.h"
+#include "CommandQueue.h"
 #include "GameObject.h"
 #include "GameSettings.h"
 #include "IVec2.h"
-#include "Camera.h"
 #include "ExtraInfoGUI.h"
 #include "GameRules.h"
+#include "Random.h"
+
+class ReplayRecorder;
+enum class EngineCounter;
+
+/// <summary>
+/// Everything Match3's simulation depends on, written by Match3::Snapshot with the cells straight after it.
+/// Only 4 byte fields so there is no padding, two snapshots of the same state compare equal with memcmp.
+/// </summary>
+struct Match3State
+{
+   enum Flags : Uint32
+   {
+      ReadyForMove = 1 << 0,
+      NoValidMoves = 1 << 1,
+      NextFrameRestarts = 1 << 2,
+      Cascading = 1 << 3
+   };
+
+   GameRules rules;
+   Uint32 tick;
+   Uint32 random_state;
+   float world_update_rate;
+   float world_update_cooldown_x;
+   Uint32 flags;
+   int game_score;
+   int game_high_score;
+   int moves_since_last_reset;
+   int cascade_depth;
+};
+static_assert(std::is_trivially_copyable<Match3State>::value, "Match3State is copied with memcpy");
+static_assert(sizeof(Match3State) == 13 * 4, "Match3State shouldn't have any padding");
 
 class Match3 : public GameObject
 {
+   // Times the private board kernels directly
+   friend class Match3Benchmark;
+
 public:
    // Used for some additional on-screen information
    ExtraInfoGUI g_extraInfo;
@@ -23,10 +59,39 @@ public:
    GameSettings* game_settings;
 
    bool g_print_ai_moves = true;
+   // Scratch board an AI plays moves out on, nothing it does counts towards the game's EngineCounters
+   bool is_search_board = false;
 
    Match3(GameSettings* settings);
+   ~Match3() override;
+   Match3(const Match3&) = delete;
+   Match3& operator=(const Match3&) = delete;
 
    const GameRules* GetRules() const;
+   // The seed actually used, random_seed 0 picks one from the time
+   Uint32 GetSeed() const { return seed_; }
+   // Starts the random sequence again from seed, for boards that don't take theirs from GameSettings. Call before GeneratePlayField.
+   void Reseed(Uint32 seed);
+   // Fixed updates run since the board was created
+   Uint32 GetTick() const { return tick_; }
+   // Milliseconds between board steps, cells fall a row each step
+   float GetUpdateRate() const { return world_update_rate_; }
+
+   // Bytes needed by Snapshot, a Match3State followed by every cell
+   size_t GetSnapshotSize() const;
+   // Copies the whole simulation state into out, which must hold GetSnapshotSize() bytes. No allocation, cheap enough to call every tick.
+   void Snapshot(void* out) const;
+   // Puts the simulation back to a snapshot's state, returns false if it was taken from a different sized board
+   bool Restore(const void* snapshot);
+   // True if a snapshot has the same cells and random state as the board, everything the next move choice depends on
+   bool HasSameBoard(const void* snapshot) const;
+
+   // Bumped by every Step, Reset and Restore. Between those the board only plays itself out, which is deterministic,
+   // so anything predicted from the board stays right until this changes.
+   Uint32 GetExternalChangeCount() const { return external_change_count_; }
+
+   // Moves and update rate changes are passed to the recorder as they happen, nullptr stops recording
+   void SetRecorder(ReplayRecorder* recorder) { recorder_ = recorder; }
 
    // Required by Technical Sheet
    void PrintWorldAsText() const;
@@ -40,6 +105,15 @@ public:
    // General Purpose
    void ProgressGame();
 
+   // The one way controllers change the game, called by the simulation as it drains its CommandQueue
+   void ApplyCommand(const Command& command);
+
+   // Board change tracking, lets the renderer only upload cells that have changed since it last looked.
+   const int* GetWorldData() const { return world_data_; }
+   Uint32 GetBoardVersion() const { return board_version_; }
+   const std::vector<int>& GetChangedCells() const { return changed_cells_; }
+   void ClearChangedCells();
+
    // Helpers
    short CheckMatches(int x, int y);
    int GetCellIndex(int x, int y) const;
@@ -48,8 +122,7 @@ public:
 
    // Inherited
    void Start() override;
-   bool Draw(Camera* camera) override;
-   void Update(double delta) override;
+   void FixedUpdate() override;
 
 private:
    float world_update_rate_ = 250.0f;
@@ -59,9 +132,16 @@ private:
    int* world_data_ = nullptr;
    GameRules game_rules_;
 
+   void AllocateWorldData();
+   // EngineCounters, skipped on search boards
+   void AddCounter(EngineCounter counter, uint64_t amount = 1) const;
+   void MaxCounter(EngineCounter counter, uint64_t amount) const;
+   void SetCell(int index, int type);
+   void MarkAllCellsChanged();
    void SwapCellValues(IVec2 from_cell, IVec2 to_cell);
-   int GetNewRandomCell() const;
+   int GetNewRandomCell();
    bool CreateCellsMissingInRow(int row);
+   bool IsRowFull(int row) const;
    void SetWorldCells(CellTypes type);
    void ResetWorld();
 
@@ -71,18 +151,25 @@ private:
 
    bool no_valid_moves_ = false;
 
+   // Incremented whenever any cell changes value
+   Uint32 board_version_ = 0;
+   // Cell indexes changed since the last ClearChangedCells, is_cell_changed_ prevents duplicates
+   std::vector<int> changed_cells_;
+   std::vector<bool> is_cell_changed_;
+
    // Filled during ClearMatches to match all cells before clearing them
    std::vector<int> world_clear_array_;
-   // Returns random number >= min <= max
-   static int InclusiveRandom(const int min, const int max)
-   {
-      return rand() % (max - min + 1) + min;
-   }
-   // OpenGL texture indexes
-   GLuint* coloured_textures_;
-   unsigned int vbo_;
-   unsigned int vao_;
-   unsigned int ebo_;
+   // Seeded from GameSettings::random_seed, each board has its own so results don't depend on other boards
+   Random random_;
+
+   // Clear rounds since the last move, while the board settles
+   int cascade_depth_ = 0;
+   bool is_cascading_ = false;
+
+   Uint32 seed_ = 0;
+   Uint32 tick_ = 0;
+   Uint32 external_change_count_ = 0;
+   ReplayRecorder* recorder_ = nullptr;
 };
 
 /// <summary> Returns the 1D Array cell index based on the X and Y passed in </summary>
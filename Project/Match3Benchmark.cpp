@@ -0,0 +1,223 @@
+#include "Match3Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "Profiler.h"
+
+namespace
+{
+   typedef std::chrono::steady_clock clock;
+   typedef std::chrono::duration<double, std::nano> nanoseconds;
+
+   // Stops the compiler throwing away kernel results
+   volatile int g_benchmark_sink = 0;
+}
+
+Match3Benchmark::Match3Benchmark(GameSettings* settings)
+{
+   game_settings_ = settings;
+   seed_ = (settings->random_seed != 0 ? settings->random_seed : 1);
+}
+
+int Match3Benchmark::Run()
+{
+   std::vector<int> sizes = { 8, 16, 32, 64, 128, 256, 512, 1024, 2048 };
+   std::vector<int> cellTypes = { 3, 4, 5, 6, 7, 8, 9 };
+   if (game_settings_->benchmark_quick)
+   {
+      sizes = { 8, 64, 512 };
+      cellTypes = { 3, 5, 9 };
+   }
+   const Fixture fixtures[] = { Fixture::Typical, Fixture::DenseMatch, Fixture::NoMove };
+
+   printf("Benchmarking Match3 kernels, seed %u\n", seed_);
+   std::vector<Result> results;
+
+   GameSettings settings = *game_settings_;
+   settings.random_seed = seed_;
+
+   for (const int size : sizes)
+   {
+      for (const int types : cellTypes)
+      {
+         for (const Fixture fixture : fixtures)
+         {
+            Match3 match3(&settings);
+            match3.g_print_ai_moves = false;
+            BuildFixture(match3, fixture, size, types);
+            const std::vector<int> cells(match3.world_data_, match3.world_data_ + match3.game_rules_.world_size_total);
+
+            IVec2 move[2] = { IVec2(0, 0), IVec2(1, 0) };
+            match3.AnyLegalMatchesExist(move);
+            RestoreFixture(match3, cells);
+
+            const size_t firstResult = results.size();
+            results.push_back(Measure("CheckMatches", match3, cells, false, [](Match3& board)
+            {
+               int found = 0;
+               for (int y = 0; y < board.game_rules_.world_height; y++)
+                  for (int x = 0; x < board.game_rules_.world_width; x++)
+                     found += board.CheckMatches(x, y);
+               g_benchmark_sink = found;
+            }));
+            results.push_back(Measure("CheckForMatches", match3, cells, false, [](Match3& board) { g_benchmark_sink = board.CheckForMatches(); }));
+            results.push_back(Measure("AnyLegalMatchesExist", match3, cells, false, [](Match3& board)
+            {
+               IVec2 found[2];
+               g_benchmark_sink = board.AnyLegalMatchesExist(found);
+            }));
+            results.push_back(Measure("ClearMatches", match3, cells, true, [](Match3& board) { g_benchmark_sink = board.ClearMatches(); }));
+            results.push_back(Measure("StepCellsDown", match3, cells, true, [](Match3& board) { g_benchmark_sink = board.StepCellsDown(); }));
+            results.push_back(Measure("CreateCellsMissingInRow", match3, cells, true, [](Match3& board) { g_benchmark_sink = board.CreateCellsMissingInRow(0); }));
+            results.push_back(Measure("Step", match3, cells, true, [&move](Match3& board) { g_benchmark_sink = board.Step(move[0], move[1]); }));
+
+            std::vector<uint8_t> snapshot(match3.GetSnapshotSize());
+            results.push_back(Measure("Snapshot", match3, cells, false, [&snapshot](Match3& board) { board.Snapshot(snapshot.data()); }));
+            // Restoring its own snapshot leaves the board as it was
+            results.push_back(Measure("Restore", match3, cells, false, [&snapshot](Match3& board) { g_benchmark_sink = board.Restore(snapshot.data()); }));
+
+            for (size_t i = firstResult; i < results.size(); i++)
+            {
+               results[i].fixture = fixture;
+               const Result& result = results[i];
+               printf("%-24s %4ix%-4i types:%i %-11s %12.1fns %8.3fns/cell\n", result.kernel, size, size, types, GetFixtureName(fixture),
+                      result.median_ns, result.median_ns / (static_cast<double>(size) * size));
+            }
+         }
+      }
+   }
+
+   return WriteJson(results) ? 0 : 1;
+}
+
+void Match3Benchmark::BuildFixture(Match3& match3, const Fixture fixture, const int size, const int cell_types) const
+{
+   match3.GeneratePlayField(size, size, cell_types);
+   switch (fixture)
+   {
+   case Fixture::Typical:
+      match3.ClearMatches();
+      break;
+   case Fixture::DenseMatch:
+      for (int y = 0; y < size; y++)
+         for (int x = 0; x < size; x++)
+            match3.world_data_[match3.GetCellIndex(x, y)] = 1 + y % cell_types;
+      break;
+   case Fixture::NoMove:
+      for (int y = 0; y < size; y++)
+         for (int x = 0; x < size; x++)
+            match3.world_data_[match3.GetCellIndex(x, y)] = 1 + (x + y) % 3;
+      if (match3.AnyLegalMatchesExist())
+         printf("Warning: No-move fixture %ix%i has a legal move\n", size, size);
+      break;
+   }
+   match3.ClearChangedCells();
+}
+
+void Match3Benchmark::RestoreFixture(Match3& match3, const std::vector<int>& cells)
+{
+   std::copy(cells.begin(), cells.end(), match3.world_data_);
+   match3.ClearChangedCells();
+}
+
+Match3Benchmark::Result Match3Benchmark::Measure(const char* kernel, Match3& match3, const std::vector<int>& cells, const bool changes_board,
+                                                 const std::function<void(Match3&)>& run) const
+{
+   // Batch up runs of kernels that leave the board alone until a batch takes at least a couple of microseconds
+   uint64_t batchSize = 1;
+   if (!changes_board)
+   {
+      while (batchSize < max_iterations)
+      {
+         const auto start = clock::now();
+         for (uint64_t i = 0; i < batchSize; i++)
+            run(match3);
+         if (static_cast<nanoseconds>(clock::now() - start).count() >= 2000.0)
+            break;
+         batchSize *= 2;
+      }
+   }
+
+   std::vector<double> samples;
+   uint64_t iterations = 0;
+   const auto caseStart = clock::now();
+   while (iterations < max_iterations &&
+          (iterations < min_iterations || static_cast<std::chrono::duration<double, std::milli>>(clock::now() - caseStart).count() < min_case_time))
+   {
+      if (changes_board)
+         RestoreFixture(match3, cells);
+
+      const auto start = clock::now();
+      for (uint64_t i = 0; i < batchSize; i++)
+         run(match3);
+      samples.push_back(static_cast<nanoseconds>(clock::now() - start).count() / batchSize);
+      iterations += batchSize;
+
+      // Kernels are profiled when ENABLE_PROFILER is on, don't let the zones pile up
+      PROFILE_END_FRAME();
+   }
+   RestoreFixture(match3, cells);
+
+   Result result{ kernel, match3.game_rules_.world_width, match3.game_rules_.cell_types_used, Fixture::Typical, iterations, 0.0, 0.0, 0.0 };
+   double total = 0.0;
+   for (const double sample : samples)
+      total += sample;
+   result.mean_ns = total / samples.size();
+   std::sort(samples.begin(), samples.end());
+   result.min_ns = samples.front();
+   result.median_ns = samples[samples.size() / 2];
+   return result;
+}
+
+bool Match3Benchmark::WriteJson(const std::vector<Result>& results) const
+{
+   const std::string& path = game_settings_->benchmark_path;
+   std::ofstream file(path);
+   if (!file.is_open())
+   {
+      printf("Failed to open benchmark output %s\n", path.c_str());
+      return false;
+   }
+
+#ifdef ENABLE_PROFILER
+   const char* profilerEnabled = "true";
+#else
+   const char* profilerEnabled = "false";
+#endif
+   // Each entry is formatted on the stack then streamed, they are far shorter than the buffer
+   char line[512];
+   snprintf(line, sizeof(line), "{\n\"context\":{\"seed\":%u,\"profiler_enabled\":%s,\"min_case_time_ms\":%.1f},\n\"benchmarks\":[", seed_, profilerEnabled, min_case_time);
+   file << line;
+   for (size_t i = 0; i < results.size(); i++)
+   {
+      const Result& result = results[i];
+      const double cells = static_cast<double>(result.size) * result.size;
+      snprintf(line, sizeof(line), "%s\n{\"name\":\"%s/%ix%i/types:%i/%s\",\"kernel\":\"%s\",\"width\":%i,\"height\":%i,\"cell_types\":%i,\"fixture\":\"%s\","
+               "\"iterations\":%llu,\"mean_ns\":%.2f,\"min_ns\":%.2f,\"median_ns\":%.2f,\"ns_per_cell\":%.4f}",
+               i == 0 ? "" : ",", result.kernel, result.size, result.size, result.cell_types, GetFixtureName(result.fixture),
+               result.kernel, result.size, result.size, result.cell_types, GetFixtureName(result.fixture),
+               static_cast<unsigned long long>(result.iterations), result.mean_ns, result.min_ns, result.median_ns, result.median_ns / cells);
+      file << line;
+   }
+   file << "\n]}\n";
+
+   printf("Wrote %zu benchmark results to %s\n", results.size(), path.c_str());
+   return true;
+}
+
+const char* Match3Benchmark::GetFixtureName(const Fixture fixture)
+{
+   switch (fixture)
+   {
+   case Fixture::Typical:
+      return "typical";
+   case Fixture::DenseMatch:
+      return "dense_match";
+   case Fixture::NoMove:
+      return "no_move";
+   }
+   return "unknown";
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "GameSettings.h"
+#include "Match3.h"
+
+/// <summary>
+/// Times the Match3 board kernels over a grid of board sizes, cell type counts and seeded fixture boards.
+/// Run with --benchmark[=path], results are printed and written as JSON so runs can be compared.
+/// </summary>
+class Match3Benchmark
+{
+public:
+   enum class Fixture
+   {
+      // Seeded random board with its starting matches cleared, holes and all
+      Typical,
+      // Every row a single type, every cell is part of a match
+      DenseMatch,
+      // Diagonal stripes of three types, nothing matches and no swap can make a match
+      NoMove
+   };
+
+   explicit Match3Benchmark(GameSettings* settings);
+
+   // Returns the process exit code
+   int Run();
+
+private:
+   struct Result
+   {
+      const char* kernel;
+      int size;
+      int cell_types;
+      Fixture fixture;
+      uint64_t iterations;
+      double mean_ns;
+      double min_ns;
+      double median_ns;
+   };
+
+   void BuildFixture(Match3& match3, Fixture fixture, int size, int cell_types) const;
+   static void RestoreFixture(Match3& match3, const std::vector<int>& cells);
+
+   // Kernels that change the board get it restored before every (individually timed) run,
+   // the rest are timed in batches so tiny boards aren't just measuring the clock
+   Result Measure(const char* kernel, Match3& match3, const std::vector<int>& cells, bool changes_board,
+                  const std::function<void(Match3&)>& run) const;
+
+   bool WriteJson(const std::vector<Result>& results) const;
+   static const char* GetFixtureName(Fixture fixture);
+
+   GameSettings* game_settings_;
+   Uint32 seed_;
+
+   // Each case runs for at least this long and this many iterations
+   static constexpr double min_case_time = 20.0;
+   static constexpr uint64_t min_iterations = 3;
+   static constexpr uint64_t max_iterations = 100000;
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/// <summary>
+/// Fixed number of same sized nodes, reserved up front. Released nodes go on a free list and are handed straight back
+/// out by the next Acquire, so building and pruning trees never touches the heap. Acquire returns nullptr once every node is in use.
+/// Not thread safe, one pool per searcher.
+/// </summary>
+template <typename T>
+class NodePool
+{
+   static_assert(std::is_trivially_destructible<T>::value, "Reset drops nodes without running destructors");
+
+public:
+   explicit NodePool(const size_t capacity)
+      : slots_(new (std::nothrow) Slot[capacity]), capacity_(slots_ ? capacity : 0)
+   {
+   }
+
+   NodePool(const NodePool&) = delete;
+   NodePool& operator=(const NodePool&) = delete;
+
+   template <typename... Args>
+   T* Acquire(Args&&... args)
+   {
+      Slot* slot = free_list_;
+      if (slot)
+         free_list_ = slot->next;
+      else if (next_unused_ < capacity_)
+         slot = &slots_[next_unused_++];
+      else
+         return nullptr;
+
+      in_use_++;
+      if (in_use_ > high_water_)
+         high_water_ = in_use_;
+      return new (slot->storage) T{ std::forward<Args>(args)... };
+   }
+
+   void Release(T* node)
+   {
+      if (!node)
+         return;
+      Slot* slot = reinterpret_cast<Slot*>(node);
+      slot->next = free_list_;
+      free_list_ = slot;
+      in_use_--;
+   }
+
+   // Releases every node at once
+   void Reset()
+   {
+      free_list_ = nullptr;
+      next_unused_ = 0;
+      in_use_ = 0;
+   }
+
+   size_t InUse() const { return in_use_; }
+   size_t Capacity() const { return capacity_; }
+   size_t HighWater() const { return high_water_; }
+
+private:
+   // A free slot's memory holds the next free slot instead of a node
+   union Slot
+   {
+      Slot* next;
+      alignas(T) unsigned char storage[sizeof(T)];
+   };
+
+   std::unique_ptr<Slot[]> slots_;
+   size_t capacity_;
+   // Slots below this have been handed out at least once, the rest have never been touched
+   size_t next_unused_ = 0;
+   Slot* free_list_ = nullptr;
+   size_t in_use_ = 0;
+   size_t high_water_ = 0;
+};
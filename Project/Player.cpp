@@ -1,23 +1,95 @@
 #include "Player.h"
 
+#include <cstdio>
+
 #include "InputManager.h"
+#include "Profiler.h"
 
 /// <summary>
 /// </summary>
-void Player::NewGame(Match3* match3)
+void Player::NewGame(Match3* match3, CommandQueue* commands)
 {
    match3_ = match3;
+   commands_ = commands;
+   requested_moves_ = 0;
+   input_cursor_ = InputManager::Instance()->CreateEventCursor();
+   worker_.reset();
+   search_.reset();
+   // Headless runs are played on virtual time and give the same image for a seed every time, when a move is made
+   // can't depend on how quickly the worker thread got to it, so they search on the simulation thread
+   if (match3->game_settings->ai_background_search && !match3->game_settings->headless)
+   {
+      worker_ = std::make_unique<AiWorker>(match3->game_settings, *match3);
+      worker_->Submit(*match3);
+      submitted_change_count_ = match3->GetExternalChangeCount();
+   }
+   else if (match3->game_settings->ai_search_depth > 0)
+      search_ = std::make_unique<AiSearch>(match3->game_settings);
 }
 
 void Player::Update(double delta)
 {
-      if (InputManager::Instance()->GetKeyDown(KeyCode::A))
-         MakeMove();
+   PROFILE_SCOPE("Player::Update");
+   // Every press counts, however many arrive between updates
+   InputEvent event;
+   while (InputManager::Instance()->PollEvent(input_cursor_, event))
+   {
+      if (event.type != InputEvent::KeyDown)
+         continue;
+      switch (static_cast<KeyCode>(event.code))
+      {
+      case KeyCode::A:
+         if (requested_moves_ < max_requested_moves)
+         {
+            requested_move_times_[(requested_move_first_ + requested_moves_) % max_requested_moves] = event.timestamp;
+            requested_moves_++;
+         }
+         break;
+      case KeyCode::Space:
+         commands_->Push(Command::Make(Command::ToggleUpdateRate, event.timestamp));
+         break;
+      case KeyCode::R:
+         commands_->Push(Command::Make(Command::Reset, event.timestamp));
+         break;
+      case KeyCode::P:
+         commands_->Push(Command::Make(Command::PrintBoard, event.timestamp));
+         break;
+      case KeyCode::L:
+         commands_->Push(Command::Make(Command::ToggleAiLog, event.timestamp));
+         break;
+      default:
+         break;
+      }
+   }
 }
 
-void Player::GetValidMove()
+void Player::FixedUpdate()
 {
-   if (match3_->AnyLegalMatchesExist(next_move_))
+   PROFILE_SCOPE("Player::FixedUpdate");
+   // A move or reset has just been applied, start on the next move while the board is still settling
+   if (worker_ && match3_->GetExternalChangeCount() != submitted_change_count_)
+   {
+      worker_->Submit(*match3_);
+      submitted_change_count_ = match3_->GetExternalChangeCount();
+   }
+   if (requested_moves_ > 0 || auto_play_)
+   {
+      if (MakeMove(requested_moves_ > 0 ? requested_move_times_[requested_move_first_] : 0) && requested_moves_ > 0)
+      {
+         requested_move_first_ = (requested_move_first_ + 1) % max_requested_moves;
+         requested_moves_--;
+      }
+   }
+}
+
+bool Player::GetValidMove()
+{
+   if (worker_)
+      return TakeWorkerMove();
+   // A search cut short by its memory cap may find nothing, the first legal move is still better than none
+   if (search_ && search_->FindMove(*match3_, next_move_))
+      is_ready_ = true;
+   else if (match3_->AnyLegalMatchesExist(next_move_))
    {
       is_ready_ = true;
    }
@@ -25,17 +97,48 @@ void Player::GetValidMove()
    {
       is_ready_ = false;
    }
+   return true;
 }
 
-void Player::MakeMove()
+// Normally the worker finished with this board ticks ago and this only picks up its move, it is never waited on
+bool Player::TakeWorkerMove()
+{
+   const AiWorker::Result result = worker_->TakeMove(*match3_, next_move_);
+   if (result == AiWorker::Result::Searching)
+      return false;
+   if (result == AiWorker::Result::Mispredicted)
+   {
+      // The board settled somewhere the worker didn't expect, like after a reset with no moves left. Search it as it is,
+      // the move is picked up on a later step.
+      worker_->Submit(*match3_);
+      submitted_change_count_ = match3_->GetExternalChangeCount();
+      return false;
+   }
+   is_ready_ = (result == AiWorker::Result::Move);
+   return true;
+}
+
+bool Player::MakeMove(const Uint32 input_time)
 {
    if (!match3_->IsReadyForMove())
-      return;
+      return false;
 
-   GetValidMove();
+   // Skip this step rather than wait for the worker
+   if (!GetValidMove())
+      return false;
 
    if (is_ready_) {
-      match3_->Step(next_move_[0], next_move_[1]);
+#ifdef ENABLE_PROFILER
+      char detail[24];
+      snprintf(detail, sizeof(detail), "(%i,%i)->(%i,%i)", next_move_[0].x, next_move_[0].y, next_move_[1].x, next_move_[1].y);
+      PROFILE_INSTANT("AI Move", detail);
+#endif
+      // Played at the start of the next fixed step
+      if (!commands_->Push(Command::MakeSwap(next_move_[0], next_move_[1], input_time)))
+         return false;
       is_ready_ = false;
    }
+   else
+      PROFILE_INSTANT("AI No Move", "");
+   return true;
 }
@@ -1,20 +1,50 @@
 #pragma once
+#include <memory>
+
+#include "AiSearch.h"
+#include "AiWorker.h"
+#include "CommandQueue.h"
 #include "GameObject.h"
+#include "InputManager.h"
 #include "Match3.h"
 
 class Player : public GameObject
 {
 public:
-   void NewGame(Match3* match3);
+   // Moves and other requests are submitted to commands, the simulation applies them on its next fixed step
+   void NewGame(Match3* match3, CommandQueue* commands);
 
    void Update(double delta) override;
+   void FixedUpdate() override;
+
+   // Returns false while the background search is still running, the move is tried again on a later fixed step
+   bool GetValidMove();
+   // Returns false if the board wasn't ready, so the move can be tried again later
+   bool MakeMove(Uint32 input_time = 0);
 
-   void GetValidMove();
-   void MakeMove();
+   // When enabled a move is made every time the board is ready, without waiting for input
+   void SetAutoPlay(bool auto_play) { auto_play_ = auto_play; }
 
 private:
    bool is_ready_ = false;
+   // Presses of the step key not played yet, each is made on a FixedUpdate once the board is ready.
+   // Kept as their SDL timestamps, oldest at requested_move_first_. Presses past max_requested_moves are ignored.
+   static constexpr int max_requested_moves = 64;
+   Uint32 requested_move_times_[max_requested_moves]{ 0 };
+   int requested_move_first_ = 0;
+   int requested_moves_ = 0;
+   InputEventCursor input_cursor_;
+   bool auto_play_ = false;
 
    IVec2 next_move_[2];
    Match3* match3_;
+   CommandQueue* commands_;
+   // Only created when GameSettings::ai_search_depth looks ahead
+   std::unique_ptr<AiSearch> search_;
+   // Used instead of search_ when ai_background_search is set
+   std::unique_ptr<AiWorker> worker_;
+   // Match3::GetExternalChangeCount when the worker was last given the board
+   Uint32 submitted_change_count_ = 0;
+
+   bool TakeWorkerMove();
 };
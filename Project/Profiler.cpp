@@ -0,0 +1,252 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+Profiler* Profiler::Instance()
+{
+   // Threads can ask for the profiler at the same time, so unlike the other managers this is created thread safe
+   static Profiler* instance = new Profiler();
+   return instance;
+}
+
+double Profiler::GetTimeMilliseconds()
+{
+   typedef std::chrono::duration<double, std::milli> duration;
+   return static_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::ThreadProfile* Profiler::GetThreadProfile()
+{
+   thread_local ThreadProfile* threadProfile = nullptr;
+   if (!threadProfile)
+      threadProfile = CreateProfile(nullptr, true);
+   return threadProfile;
+}
+
+Profiler::ThreadProfile* Profiler::CreateProfile(const char* name, const bool is_thread)
+{
+   std::lock_guard<std::mutex> lock(threads_mutex_);
+   threads_.push_back(std::make_unique<ThreadProfile>());
+   ThreadProfile* profile = threads_.back().get();
+   profile->name = (name ? name : "Thread " + std::to_string(threads_.size()));
+   profile->is_thread = is_thread;
+   profile->current_zones.reserve(64);
+   profile->open_zones.reserve(16);
+   profile->last_frame_zones.reserve(64);
+   profile->frame_start = GetTimeMilliseconds();
+   return profile;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+   ThreadProfile* profile = GetThreadProfile();
+   std::lock_guard<std::mutex> lock(profile->mutex);
+   profile->name = name;
+}
+
+void Profiler::BeginZone(const char* name)
+{
+   ThreadProfile* profile = GetThreadProfile();
+   if (profile->suspend_depth > 0)
+      return;
+   const int depth = static_cast<int>(profile->open_zones.size());
+   profile->open_zones.push_back(static_cast<int>(profile->current_zones.size()));
+   profile->current_zones.push_back({ name, GetTimeMilliseconds() - profile->frame_start, 0.0, depth });
+}
+
+void Profiler::EndZone()
+{
+   ThreadProfile* profile = GetThreadProfile();
+   if (profile->suspend_depth > 0 || profile->open_zones.empty())
+      return;
+
+   Zone& zone = profile->current_zones[profile->open_zones.back()];
+   zone.duration = GetTimeMilliseconds() - profile->frame_start - zone.start;
+   profile->open_zones.pop_back();
+
+   profile->trace.Push({ zone.name, profile->frame_start + zone.start, zone.duration, "" });
+}
+
+void Profiler::Suspend()
+{
+   GetThreadProfile()->suspend_depth++;
+}
+
+void Profiler::Resume()
+{
+   ThreadProfile* profile = GetThreadProfile();
+   if (profile->suspend_depth > 0)
+      profile->suspend_depth--;
+}
+
+void Profiler::RecordInstant(const char* name, const char* detail)
+{
+   TraceEvent traceEvent{ name, GetTimeMilliseconds(), -1.0, "" };
+   snprintf(traceEvent.detail, sizeof(traceEvent.detail), "%s", detail);
+   GetThreadProfile()->trace.Push(traceEvent);
+}
+
+void Profiler::RecordGpuEvent(const char* name, const double start, const double duration)
+{
+   if (!gpu_track_)
+      gpu_track_ = CreateProfile("GPU", false);
+   gpu_track_->trace.Push({ name, start, duration, "" });
+}
+
+void Profiler::RecordLatencyEvent(const char* name, const double start, const double duration)
+{
+   if (!latency_track_)
+      latency_track_ = CreateProfile("Latency", false);
+   latency_track_->trace.Push({ name, start, duration, "" });
+}
+
+void Profiler::SetTraceMetadata(const char* key, const double value)
+{
+   std::lock_guard<std::mutex> lock(threads_mutex_);
+   for (auto& entry : trace_metadata_)
+   {
+      if (entry.first == key)
+      {
+         entry.second = value;
+         return;
+      }
+   }
+   trace_metadata_.emplace_back(key, value);
+}
+
+void Profiler::EndFrame()
+{
+   ThreadProfile* profile = GetThreadProfile();
+   const double now = GetTimeMilliseconds();
+
+   // Zones still open belong to the next frame
+   size_t finishedCount = profile->current_zones.size();
+   if (!profile->open_zones.empty())
+      finishedCount = profile->open_zones.front();
+
+   {
+      std::lock_guard<std::mutex> lock(profile->mutex);
+      profile->last_frame_zones.assign(profile->current_zones.begin(), profile->current_zones.begin() + finishedCount);
+      profile->last_frame_time = now - profile->frame_start;
+
+      // Every known zone gets a sample, so zones that didn't run this frame show as 0
+      for (int i = 0; i < profile->zone_history_count; i++)
+         profile->zone_history[i].frame_totals[profile->zone_history[i].history_index] = 0.0f;
+      for (const Zone& zone : profile->last_frame_zones)
+      {
+         ZoneHistory* history = profile->FindZoneHistory(zone.name);
+         if (!history && profile->zone_history_count < max_zone_histories)
+         {
+            history = &profile->zone_history[profile->zone_history_count++];
+            history->name = zone.name;
+         }
+         if (history)
+            history->frame_totals[history->history_index] += static_cast<float>(zone.duration);
+      }
+      for (int i = 0; i < profile->zone_history_count; i++)
+      {
+         ZoneHistory& history = profile->zone_history[i];
+         history.history_index = (history.history_index + 1) % history_size;
+         if (history.history_count < history_size)
+            history.history_count++;
+      }
+   }
+
+   // Carry open zones over, rebased on the new frame start
+   profile->current_zones.erase(profile->current_zones.begin(), profile->current_zones.begin() + finishedCount);
+   for (Zone& zone : profile->current_zones)
+      zone.start -= now - profile->frame_start;
+   for (int& openZone : profile->open_zones)
+      openZone -= static_cast<int>(finishedCount);
+   profile->frame_start = now;
+}
+
+Profiler::ZoneHistory* Profiler::ThreadProfile::FindZoneHistory(const char* zone_name)
+{
+   // Zones are grouped by pointer, and there are few enough that a linear search beats hashing
+   for (int i = 0; i < zone_history_count; i++)
+   {
+      if (zone_history[i].name == zone_name)
+         return &zone_history[i];
+   }
+   return nullptr;
+}
+
+std::vector<Profiler::ThreadProfile*> Profiler::GetThreads()
+{
+   std::lock_guard<std::mutex> lock(threads_mutex_);
+   std::vector<ThreadProfile*> threads;
+   for (auto& thread : threads_)
+      threads.push_back(thread.get());
+   return threads;
+}
+
+bool Profiler::ExportTrace(const std::string& path)
+{
+   std::ofstream file(path);
+   if (!file.is_open())
+   {
+      printf("Failed to open trace file %s\n", path.c_str());
+      return false;
+   }
+
+   std::vector<TraceEvent> events;
+   events.reserve(TraceBuffer::capacity);
+   size_t eventCount = 0;
+   bool isFirst = true;
+
+   file << std::fixed << std::setprecision(3);
+   file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{";
+   {
+      std::lock_guard<std::mutex> lock(threads_mutex_);
+      for (size_t i = 0; i < trace_metadata_.size(); i++)
+         file << (i == 0 ? "" : ",") << '"' << trace_metadata_[i].first << "\":" << trace_metadata_[i].second;
+   }
+   file << "},\"traceEvents\":[\n";
+   const std::vector<ThreadProfile*> threads = GetThreads();
+   for (size_t threadId = 0; threadId < threads.size(); threadId++)
+   {
+      ThreadProfile* thread = threads[threadId];
+      {
+         std::lock_guard<std::mutex> lock(thread->mutex);
+         file << (isFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadId
+              << ",\"args\":{\"name\":\"" << thread->name << "\"}}";
+         isFirst = false;
+      }
+
+      events.clear();
+      thread->trace.CopyTo(events);
+      for (const TraceEvent& traceEvent : events)
+      {
+         // Chrome traces are in microseconds
+         const double start = (traceEvent.start - start_time_) * 1000.0;
+         if (traceEvent.duration < 0.0)
+            file << ",\n{\"name\":\"" << traceEvent.name << "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << start
+                 << ",\"pid\":1,\"tid\":" << threadId << ",\"args\":{\"detail\":\"" << traceEvent.detail << "\"}}";
+         else
+            file << ",\n{\"name\":\"" << traceEvent.name << "\",\"ph\":\"X\",\"ts\":" << start
+                 << ",\"dur\":" << traceEvent.duration * 1000.0 << ",\"pid\":1,\"tid\":" << threadId << "}";
+      }
+      eventCount += events.size();
+   }
+   file << "\n]}\n";
+
+   printf("Wrote %zu trace events to %s\n", eventCount, path.c_str());
+   return true;
+}
+
+float Profiler::GetPercentile(const ZoneHistory& history, const float percentile)
+{
+   if (history.history_count == 0)
+      return 0.0f;
+
+   float samples[history_size];
+   std::copy(history.frame_totals, history.frame_totals + history.history_count, samples);
+   const int index = std::min(history.history_count - 1, static_cast<int>(percentile * history.history_count));
+   std::nth_element(samples, samples + index, samples + history.history_count);
+   return samples[index];
+}
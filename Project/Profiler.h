@@ -0,0 +1,162 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TraceBuffer.h"
+
+/// <summary>
+/// Scoped CPU timing, zones nest into a hierarchy per thread and per frame.
+/// Each thread keeps its own zones and calls EndFrame at its own frame boundary (render frame, simulation update),
+/// which hands the frame over to be shown in the profiler window.
+/// Every finished zone also goes into the thread's trace buffer, which can be exported as a Chrome trace (chrome://tracing, Perfetto).
+/// Use the PROFILE_ macros, they compile to nothing unless ENABLE_PROFILER is defined.
+/// </summary>
+class Profiler
+{
+public:
+   static constexpr int history_size = 240;
+   // Distinct zones a thread keeps history for, zones past this still show in the timeline
+   static constexpr int max_zone_histories = 64;
+
+   struct Zone
+   {
+      const char* name;
+      // Milliseconds since the start of the frame
+      double start;
+      double duration;
+      int depth;
+   };
+
+   struct ZoneHistory
+   {
+      const char* name = nullptr;
+      // Total time spent in the zone per frame, oldest first from history_index
+      float frame_totals[history_size]{ 0.0f };
+      int history_index = 0;
+      int history_count = 0;
+   };
+
+   struct ThreadProfile
+   {
+      std::string name;
+      // False for tracks like the GPU that only exist in traces
+      bool is_thread = true;
+
+      // Written by the owning thread only, read by ExportTrace
+      TraceBuffer trace;
+
+      // Only touched by the owning thread
+      std::vector<Zone> current_zones;
+      std::vector<int> open_zones;
+      double frame_start = 0.0;
+      // Zones aren't recorded while this is above 0, see ProfileSuspendScope
+      int suspend_depth = 0;
+
+      // Handed over on EndFrame, guarded by mutex
+      std::mutex mutex;
+      std::vector<Zone> last_frame_zones;
+      double last_frame_time = 0.0;
+      // Fixed size, so a zone seen for the first time doesn't allocate mid-session
+      ZoneHistory zone_history[max_zone_histories];
+      int zone_history_count = 0;
+
+      // Null if the zone hasn't been seen, caller must hold the mutex
+      ZoneHistory* FindZoneHistory(const char* zone_name);
+   };
+
+   static Profiler* Instance();
+
+   // Name shown for the calling thread
+   void SetThreadName(const char* name);
+
+   void BeginZone(const char* name);
+   void EndZone();
+   // Finishes the calling thread's frame, zones still open carry on into the next frame
+   void EndFrame();
+   // Stops (and restarts) recording zones on the calling thread, nests
+   void Suspend();
+   void Resume();
+
+   // Point in time event on the calling thread, detail is cut to fit TraceEvent
+   void RecordInstant(const char* name, const char* detail);
+   // GPU pass on the GPU track, times are on the profiler clock. Only call from the render thread.
+   void RecordGpuEvent(const char* name, double start, double duration);
+   // Span from an input to the frame that showed its result, on the Latency track. Only call from the render thread.
+   void RecordLatencyEvent(const char* name, double start, double duration);
+   // Summary value written into the trace's otherData, replaces any earlier value for the key
+   void SetTraceMetadata(const char* key, double value);
+
+   /// <summary> Writes every thread's trace buffer as Chrome Trace Event JSON. </summary>
+   bool ExportTrace(const std::string& path);
+
+   // Threads that have recorded anything, lock a profile's mutex before reading its frame data
+   std::vector<ThreadProfile*> GetThreads();
+
+   /// <summary> Percentile (0-1) of a zone's per-frame totals, caller must hold the profile's mutex. </summary>
+   static float GetPercentile(const ZoneHistory& history, float percentile);
+
+   static double GetTimeMilliseconds();
+
+private:
+   Profiler() = default;
+
+   ThreadProfile* GetThreadProfile();
+   ThreadProfile* CreateProfile(const char* name, bool is_thread);
+
+   std::mutex threads_mutex_;
+   std::vector<std::unique_ptr<ThreadProfile>> threads_;
+   ThreadProfile* gpu_track_ = nullptr;
+   ThreadProfile* latency_track_ = nullptr;
+   // Guarded by threads_mutex_
+   std::vector<std::pair<std::string, double>> trace_metadata_;
+
+   // Trace timestamps are written relative to this
+   double start_time_ = GetTimeMilliseconds();
+};
+
+/// <summary> Times the enclosing scope as a zone. </summary>
+class ProfileScope
+{
+public:
+   explicit ProfileScope(const char* name) { Profiler::Instance()->BeginZone(name); }
+   ~ProfileScope() { Profiler::Instance()->EndZone(); }
+
+   ProfileScope(const ProfileScope&) = delete;
+   ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+/// <summary> Hides zones opened inside the scope, for code like the AI search that runs the board kernels thousands of times a frame. </summary>
+class ProfileSuspendScope
+{
+public:
+   ProfileSuspendScope() { Profiler::Instance()->Suspend(); }
+   ~ProfileSuspendScope() { Profiler::Instance()->Resume(); }
+
+   ProfileSuspendScope(const ProfileSuspendScope&) = delete;
+   ProfileSuspendScope& operator=(const ProfileSuspendScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_PROFILER
+// Name must be a string literal, zones are grouped by pointer
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_END_FRAME() Profiler::Instance()->EndFrame()
+#define PROFILE_THREAD_NAME(name) Profiler::Instance()->SetThreadName(name)
+#define PROFILE_INSTANT(name, detail) Profiler::Instance()->RecordInstant(name, detail)
+#define PROFILE_GPU_EVENT(name, start, duration) Profiler::Instance()->RecordGpuEvent(name, start, duration)
+#define PROFILE_LATENCY_EVENT(name, start, duration) Profiler::Instance()->RecordLatencyEvent(name, start, duration)
+#define PROFILE_SUSPEND() ProfileSuspendScope PROFILE_CONCAT(profile_suspend_, __LINE__)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_END_FRAME()
+#define PROFILE_THREAD_NAME(name)
+#define PROFILE_INSTANT(name, detail)
+#define PROFILE_GPU_EVENT(name, start, duration)
+#define PROFILE_LATENCY_EVENT(name, start, duration)
+#define PROFILE_SUSPEND()
+#endif
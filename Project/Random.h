@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+/// <summary>
+/// Small xorshift generator, the whole state is a single value so boards can be seeded, copied and replayed.
+/// </summary>
+struct Random
+{
+   uint32_t state = 2463534242u;
+
+   // Zero would lock the generator at zero forever, so it is replaced with the default state
+   void Seed(const uint32_t seed)
+   {
+      state = (seed == 0 ? 2463534242u : seed);
+   }
+
+   uint32_t Next()
+   {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return state;
+   }
+
+   // Returns random number >= min <= max
+   int Range(const int min, const int max)
+   {
+      return static_cast<int>(Next() % static_cast<uint32_t>(max - min + 1)) + min;
+   }
+};
@@ -0,0 +1,415 @@
+#include "Replay.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "Match3.h"
+#include "Profiler.h"
+
+namespace
+{
+   const char header_magic[4] = { 'M', '3', 'R', 'P' };
+   const char footer_magic[4] = { 'M', '3', 'R', 'I' };
+   // magic, version, keyframe interval, seed, width, height, cell types, fixed update time
+   constexpr size_t header_size = 4 + 2 + 2 + 4 + 4 + 4 + 4 + 8;
+   // keyframe count, index offset, magic
+   constexpr size_t footer_size = 4 + 8 + 4;
+   constexpr size_t keyframe_index_size = 8 + 4 + 4;
+   // Larger than any board the game or the benchmark makes
+   constexpr int max_world_size = 4096;
+
+   template <typename T>
+   void WriteValue(std::vector<uint8_t>& out, const T value)
+   {
+      const size_t offset = out.size();
+      out.resize(offset + sizeof(T));
+      memcpy(out.data() + offset, &value, sizeof(T));
+   }
+
+   template <typename T>
+   T ReadValue(const uint8_t*& data)
+   {
+      T value;
+      memcpy(&value, data, sizeof(T));
+      data += sizeof(T);
+      return value;
+   }
+
+   void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+   {
+      while (value >= 0x80)
+      {
+         out.push_back(static_cast<uint8_t>(value | 0x80));
+         value >>= 7;
+      }
+      out.push_back(static_cast<uint8_t>(value));
+   }
+
+   // Readers of the records check against end, the file could be cut short or damaged anywhere
+   template <typename T>
+   bool ReadValue(const uint8_t*& data, const uint8_t* end, T& value)
+   {
+      if (static_cast<size_t>(end - data) < sizeof(T))
+         return false;
+      value = ReadValue<T>(data);
+      return true;
+   }
+
+   bool ReadVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value)
+   {
+      value = 0;
+      // 5 bytes of 7 bits covers a uint32
+      for (int shift = 0; shift < 35 && data < end; shift += 7)
+      {
+         const uint8_t byte = *data++;
+         value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+         if (!(byte & 0x80))
+            return true;
+      }
+      return false;
+   }
+
+   // Small negative values stay small
+   void WriteZigZag(std::vector<uint8_t>& out, const int value)
+   {
+      WriteVarint(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+   }
+
+   bool ReadZigZag(const uint8_t*& data, const uint8_t* end, int& value)
+   {
+      uint32_t encoded;
+      if (!ReadVarint(data, end, encoded))
+         return false;
+      value = static_cast<int>(encoded >> 1) ^ -static_cast<int>(encoded & 1);
+      return true;
+   }
+}
+
+ReplayRecorder::ReplayRecorder(std::string path, const uint16_t keyframe_interval)
+   : path_(std::move(path)), keyframe_interval_(keyframe_interval > 0 ? keyframe_interval : 1)
+{
+}
+
+void ReplayRecorder::Begin(const Match3& match3, const GameSettings& settings)
+{
+   buffer_.clear();
+   keyframes_.clear();
+   buffer_.insert(buffer_.end(), header_magic, header_magic + 4);
+   WriteValue<uint16_t>(buffer_, ReplayFormat::version);
+   WriteValue<uint16_t>(buffer_, keyframe_interval_);
+   WriteValue<uint32_t>(buffer_, match3.GetSeed());
+   WriteValue<int32_t>(buffer_, match3.GetRules()->world_width);
+   WriteValue<int32_t>(buffer_, match3.GetRules()->world_height);
+   WriteValue<int32_t>(buffer_, match3.GetRules()->cell_types_used);
+   WriteValue<double>(buffer_, settings.fixed_update_time);
+
+   last_tick_ = match3.GetTick();
+   move_count_ = 0;
+   WriteKeyframe(match3);
+}
+
+void ReplayRecorder::WriteRecordStart(const ReplayFormat::RecordType type, const Uint32 tick)
+{
+   buffer_.push_back(type);
+   WriteVarint(buffer_, tick - last_tick_);
+   last_tick_ = tick;
+}
+
+void ReplayRecorder::WriteKeyframe(const Match3& match3)
+{
+   keyframes_.push_back({ buffer_.size(), match3.GetTick(), move_count_ });
+   WriteRecordStart(ReplayFormat::Keyframe, match3.GetTick());
+   WriteVarint(buffer_, move_count_);
+   const size_t offset = buffer_.size();
+   buffer_.resize(offset + match3.GetSnapshotSize());
+   match3.Snapshot(buffer_.data() + offset);
+   last_keyframe_move_ = move_count_;
+}
+
+void ReplayRecorder::RecordMove(const Uint32 tick, const IVec2 from_cell, const IVec2 to_cell)
+{
+   WriteRecordStart(ReplayFormat::Move, tick);
+   WriteZigZag(buffer_, from_cell.x);
+   WriteZigZag(buffer_, from_cell.y);
+   WriteZigZag(buffer_, to_cell.x);
+   WriteZigZag(buffer_, to_cell.y);
+   move_count_++;
+}
+
+void ReplayRecorder::RecordUpdateRate(const Uint32 tick, const float update_rate)
+{
+   WriteRecordStart(ReplayFormat::UpdateRate, tick);
+   WriteValue<float>(buffer_, update_rate);
+}
+
+void ReplayRecorder::RecordReset(const Uint32 tick)
+{
+   WriteRecordStart(ReplayFormat::Reset, tick);
+}
+
+void ReplayRecorder::OnFixedUpdate(const Match3& match3)
+{
+   if (move_count_ - last_keyframe_move_ >= keyframe_interval_)
+      WriteKeyframe(match3);
+}
+
+bool ReplayRecorder::Finish(const Match3& match3)
+{
+   WriteRecordStart(ReplayFormat::End, match3.GetTick());
+
+   const uint64_t indexOffset = buffer_.size();
+   for (const auto& keyframe : keyframes_)
+   {
+      WriteValue<uint64_t>(buffer_, keyframe.offset);
+      WriteValue<uint32_t>(buffer_, keyframe.tick);
+      WriteValue<uint32_t>(buffer_, keyframe.move_number);
+   }
+   WriteValue<uint32_t>(buffer_, static_cast<uint32_t>(keyframes_.size()));
+   WriteValue<uint64_t>(buffer_, indexOffset);
+   buffer_.insert(buffer_.end(), footer_magic, footer_magic + 4);
+
+   std::ofstream file(path_, std::ios::binary);
+   if (!file.is_open() || !file.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size()))
+   {
+      printf("Failed to write replay %s\n", path_.c_str());
+      return false;
+   }
+   printf("Replay: %u moves over %u ticks written to %s (%zu bytes)\n", move_count_, match3.GetTick(), path_.c_str(), buffer_.size());
+   return true;
+}
+
+bool ReplayReader::Open(const std::string& path)
+{
+   if (!file_.Open(path))
+      return false;
+
+   const uint8_t* data = file_.Data();
+   const size_t size = file_.Size();
+   if (size < header_size + footer_size || memcmp(data, header_magic, 4) != 0 || memcmp(data + size - 4, footer_magic, 4) != 0)
+   {
+      printf("%s is not a complete replay\n", path.c_str());
+      return false;
+   }
+
+   const uint8_t* header = data + 4;
+   const uint16_t version = ReadValue<uint16_t>(header);
+   if (version != ReplayFormat::version)
+   {
+      printf("Replay version %u is not supported (expected %u)\n", version, ReplayFormat::version);
+      return false;
+   }
+   ReadValue<uint16_t>(header);
+   seed_ = ReadValue<uint32_t>(header);
+   world_width_ = ReadValue<int32_t>(header);
+   world_height_ = ReadValue<int32_t>(header);
+   cell_types_used_ = ReadValue<int32_t>(header);
+   fixed_update_time_ = ReadValue<double>(header);
+   // The board is allocated from these, don't trust them any more than the records
+   if (world_width_ < 3 || world_height_ < 3 || world_width_ > max_world_size || world_height_ > max_world_size ||
+       cell_types_used_ < 3 || cell_types_used_ >= CELL_TYPE_COUNT || !(fixed_update_time_ > 0.0))
+   {
+      printf("%s has a damaged header\n", path.c_str());
+      return false;
+   }
+
+   const uint8_t* footer = data + size - footer_size;
+   keyframe_count_ = ReadValue<uint32_t>(footer);
+   const uint64_t indexOffset = ReadValue<uint64_t>(footer);
+   if (indexOffset < header_size || indexOffset > size || indexOffset + keyframe_count_ * keyframe_index_size + footer_size != size)
+   {
+      printf("%s has a damaged keyframe index\n", path.c_str());
+      return false;
+   }
+
+   records_ = data;
+   records_size_ = static_cast<size_t>(indexOffset);
+   keyframe_index_ = data + indexOffset;
+   return true;
+}
+
+ReplayFormat::KeyframeIndex ReplayReader::GetKeyframe(const uint32_t index) const
+{
+   const uint8_t* entry = keyframe_index_ + index * keyframe_index_size;
+   ReplayFormat::KeyframeIndex keyframe;
+   keyframe.offset = ReadValue<uint64_t>(entry);
+   keyframe.tick = ReadValue<uint32_t>(entry);
+   keyframe.move_number = ReadValue<uint32_t>(entry);
+   return keyframe;
+}
+
+Match3* ReplayReader::CreateMatch3(GameSettings* settings) const
+{
+   settings->random_seed = seed_;
+   settings->world_size = IVec2(world_width_, world_height_);
+   settings->cell_types_used = cell_types_used_;
+   settings->fixed_update_time = fixed_update_time_;
+
+   Match3* match3 = new Match3(settings);
+   match3->g_print_ai_moves = false;
+   return match3;
+}
+
+bool ReplayReader::Play(Match3& match3, size_t offset, Uint32 moves, const Uint32 stop_at_move, const bool verify_keyframes)
+{
+   // Playback runs every recorded tick with no frames ending, keep its zones out of the trace like a search board's
+   PROFILE_SUSPEND();
+   std::vector<uint8_t> state(match3.GetSnapshotSize());
+   Uint32 tick = match3.GetTick();
+   const uint8_t* data = records_ + offset;
+   const uint8_t* end = records_ + records_size_;
+
+   while (data < end && moves < stop_at_move)
+   {
+      const uint8_t type = *data++;
+      uint32_t tickDelta;
+      if (!ReadVarint(data, end, tickDelta))
+         return ReportDamage(data);
+      tick += tickDelta;
+      // Everything between records is just the simulation running
+      while (match3.GetTick() < tick)
+         match3.FixedUpdate();
+
+      switch (type)
+      {
+      case ReplayFormat::Move:
+      {
+         int fromX, fromY, toX, toY;
+         if (!ReadZigZag(data, end, fromX) || !ReadZigZag(data, end, fromY) || !ReadZigZag(data, end, toX) || !ReadZigZag(data, end, toY))
+            return ReportDamage(data);
+         // Match3 never records a move off the board
+         if (!match3.IsValidCell(fromX, fromY) || !match3.IsValidCell(toX, toY))
+         {
+            printf("Replay has a move off the board (%i,%i)->(%i,%i) at tick %u\n", fromX, fromY, toX, toY, tick);
+            return false;
+         }
+         match3.ApplyCommand(Command::MakeSwap(IVec2(fromX, fromY), IVec2(toX, toY)));
+         moves++;
+         break;
+      }
+      case ReplayFormat::UpdateRate:
+      {
+         Command command = Command::Make(Command::SetUpdateRate);
+         if (!ReadValue<float>(data, end, command.value))
+            return ReportDamage(data);
+         match3.ApplyCommand(command);
+         break;
+      }
+      case ReplayFormat::Reset:
+         match3.ApplyCommand(Command::Make(Command::Reset));
+         break;
+      case ReplayFormat::Keyframe:
+      {
+         uint32_t keyframeMove;
+         if (!ReadVarint(data, end, keyframeMove) || static_cast<size_t>(end - data) < state.size())
+            return ReportDamage(data);
+         if (verify_keyframes)
+         {
+            match3.Snapshot(state.data());
+            if (memcmp(state.data(), data, state.size()) != 0)
+            {
+               printf("Replay diverged at tick %u after %u moves\n", tick, moves);
+               return false;
+            }
+            keyframes_checked_++;
+         }
+         data += state.size();
+         break;
+      }
+      case ReplayFormat::End:
+         total_ticks_ = tick;
+         total_moves_ = moves;
+         return true;
+      default:
+         printf("Unknown replay record %u\n", type);
+         return false;
+      }
+   }
+   total_moves_ = moves;
+   return true;
+}
+
+bool ReplayReader::ReportDamage(const uint8_t* data) const
+{
+   printf("Replay is damaged, a record runs past the end at offset %zu\n", static_cast<size_t>(data - records_));
+   return false;
+}
+
+int ReplayReader::PlayAll(GameSettings* settings)
+{
+   Match3* match3 = CreateMatch3(settings);
+   // Same as Match3::Start, the first keyframe then checks the seed really does give the recorded board
+   match3->GeneratePlayField(world_width_, world_height_, cell_types_used_);
+
+   const auto start = std::chrono::steady_clock::now();
+   const bool isMatching = Play(*match3, header_size, 0, UINT32_MAX, true);
+   const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+   printf("Replay: %u moves, %u ticks (%0.1fs simulated) played in %0.2fms, %u/%u keyframes matched, score %i\n",
+          total_moves_, total_ticks_, total_ticks_ * fixed_update_time_ / 1000.0, elapsed, keyframes_checked_, keyframe_count_,
+          match3->g_extraInfo.game_score);
+   delete match3;
+   return isMatching ? 0 : 1;
+}
+
+bool ReplayReader::SeekToMove(Match3& match3, const Uint32 move_number)
+{
+   if (keyframe_count_ == 0)
+      return false;
+
+   // Last keyframe at or before the move
+   uint32_t low = 0;
+   uint32_t high = keyframe_count_ - 1;
+   while (low < high)
+   {
+      const uint32_t middle = (low + high + 1) / 2;
+      if (GetKeyframe(middle).move_number <= move_number)
+         low = middle;
+      else
+         high = middle - 1;
+   }
+   const ReplayFormat::KeyframeIndex keyframe = GetKeyframe(low);
+   if (keyframe.offset < header_size || keyframe.offset >= records_size_ || records_[keyframe.offset] != ReplayFormat::Keyframe)
+   {
+      printf("Replay keyframe %u points outside the records\n", low);
+      return false;
+   }
+
+   // Keyframe record: type, tick delta, move number, then the state
+   const uint8_t* data = records_ + keyframe.offset + 1;
+   const uint8_t* end = records_ + records_size_;
+   uint32_t value;
+   if (!ReadVarint(data, end, value) || !ReadVarint(data, end, value) || static_cast<size_t>(end - data) < match3.GetSnapshotSize())
+      return ReportDamage(data);
+   if (!match3.Restore(data))
+      return false;
+
+   const size_t next = static_cast<size_t>(data - records_) + match3.GetSnapshotSize();
+   return Play(match3, next, keyframe.move_number, move_number, false) && total_moves_ >= move_number;
+}
+
+int ReplayReader::Run(GameSettings* settings)
+{
+   ReplayReader reader;
+   if (!reader.Open(settings->replay_path))
+      return 1;
+
+   if (settings->replay_seek_move < 0)
+      return reader.PlayAll(settings);
+
+   Match3* match3 = reader.CreateMatch3(settings);
+   match3->GeneratePlayField(reader.world_width_, reader.world_height_, reader.cell_types_used_);
+
+   const auto start = std::chrono::steady_clock::now();
+   const bool isFound = reader.SeekToMove(*match3, static_cast<Uint32>(settings->replay_seek_move));
+   const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+   if (isFound)
+      printf("Replay: seeked to move %i (tick %u) in %0.3fms\n", settings->replay_seek_move, match3->GetTick(), elapsed);
+   else
+      printf("Replay: only has %u moves, stopped at the end\n", reader.total_moves_);
+   match3->PrintWorldAsText();
+   delete match3;
+   return isFound ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GameSettings.h"
+#include "IVec2.h"
+#include "MappedFile.h"
+
+class Match3;
+
+/// <summary>
+/// Binary replay format, little endian:
+///   Header   - magic "M3RP", version, keyframe interval, seed, GameRules, fixed update time
+///   Records  - type byte, varint tick delta, then the record's data
+///              Move: zigzag varint from x/y and to x/y, one per Match3::Step call on the board (rejected ones too, they reset the cooldown)
+///              UpdateRate: float, the 50ms/250ms toggle
+///              Reset: no data, the board was cleared by a Reset command
+///              Keyframe: varint move number, then a Match3::Snapshot
+///              End: the session's last tick
+///   Index    - offset, tick and move number of every keyframe, so seeking doesn't scan the records
+///   Footer   - keyframe count, index offset, magic "M3RI"
+/// Everything Match3 does between records is deterministic given the seed, so ticks and moves are all that is stored.
+/// </summary>
+namespace ReplayFormat
+{
+   constexpr uint16_t version = 3;
+
+   enum RecordType : uint8_t
+   {
+      Move = 0,
+      UpdateRate = 1,
+      Keyframe = 2,
+      End = 3,
+      Reset = 4
+   };
+
+   struct KeyframeIndex
+   {
+      uint64_t offset;
+      uint32_t tick;
+      uint32_t move_number;
+   };
+}
+
+/// <summary>
+/// Records a Match3 session. Match3 calls in as things happen, the file is written by Finish.
+/// Only used from the thread running the simulation.
+/// </summary>
+class ReplayRecorder
+{
+public:
+   ReplayRecorder(std::string path, uint16_t keyframe_interval);
+
+   // Writes the header and the first keyframe, call once the board has been generated
+   void Begin(const Match3& match3, const GameSettings& settings);
+
+   void RecordMove(Uint32 tick, IVec2 from_cell, IVec2 to_cell);
+   void RecordUpdateRate(Uint32 tick, float update_rate);
+   void RecordReset(Uint32 tick);
+   // Called at the start of each fixed update, writes a keyframe once enough moves have been made since the last
+   void OnFixedUpdate(const Match3& match3);
+
+   bool Finish(const Match3& match3);
+
+private:
+   void WriteRecordStart(ReplayFormat::RecordType type, Uint32 tick);
+   void WriteKeyframe(const Match3& match3);
+
+   std::string path_;
+   uint16_t keyframe_interval_;
+   std::vector<uint8_t> buffer_;
+   std::vector<ReplayFormat::KeyframeIndex> keyframes_;
+   Uint32 last_tick_ = 0;
+   Uint32 move_count_ = 0;
+   Uint32 last_keyframe_move_ = 0;
+};
+
+/// <summary>
+/// Plays a replay back as fast as possible without rendering. Keyframes hit along the way are checked against the
+/// simulated board, so any divergence is reported. Seeking restores the nearest keyframe before the move and plays on from there.
+/// </summary>
+class ReplayReader
+{
+public:
+   bool Open(const std::string& path);
+
+   // Plays the whole replay from the seed, returns the process exit code (1 if it diverged)
+   int PlayAll(GameSettings* settings);
+   // Leaves the board as it was right after move_number, returns false if the replay doesn't have that many moves
+   bool SeekToMove(Match3& match3, Uint32 move_number);
+
+   // Creates a Match3 set up with the replay's seed and rules, without a board
+   Match3* CreateMatch3(GameSettings* settings) const;
+
+   /// <summary> Replay mode entry point, plays (or seeks) settings->replay_path. </summary>
+   static int Run(GameSettings* settings);
+
+private:
+   // Applies records from offset until the move count reaches stop_at_move, or the end.
+   // Returns false if a keyframe didn't match when verifying, or the records are damaged.
+   bool Play(Match3& match3, size_t offset, Uint32 moves, Uint32 stop_at_move, bool verify_keyframes);
+   // Prints where the records ran out, always returns false
+   bool ReportDamage(const uint8_t* data) const;
+
+   // The index isn't aligned in the file, so entries are copied out
+   ReplayFormat::KeyframeIndex GetKeyframe(uint32_t index) const;
+
+   MappedFile file_;
+   const uint8_t* records_ = nullptr;
+   size_t records_size_ = 0;
+   const uint8_t* keyframe_index_ = nullptr;
+   uint32_t keyframe_count_ = 0;
+
+   Uint32 seed_ = 0;
+   int world_width_ = 0;
+   int world_height_ = 0;
+   int cell_types_used_ = 0;
+   double fixed_update_time_ = 0.0;
+
+   Uint32 total_ticks_ = 0;
+   Uint32 total_moves_ = 0;
+   Uint32 keyframes_checked_ = 0;
+};
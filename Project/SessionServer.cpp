@@ -0,0 +1,593 @@
+#include "SessionServer.h"
+
+#include <cstdio>
+
+#ifdef __linux__
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "CellTypes.h"
+#include "Match3.h"
+#include "Profiler.h"
+
+namespace
+{
+   using namespace SessionProtocol;
+
+   // Sessions one connection can have open at once, a connection past this gets TooManySessions
+   constexpr size_t max_sessions_per_connection = 4096;
+   // A cascade settles well within this, it only guards against a board that never does
+   constexpr int max_settle_steps = 4096;
+   constexpr int max_epoll_events = 256;
+   // Milliseconds between checks for a stop signal
+   constexpr int epoll_timeout = 100;
+   // Stop reading from a client that has this much unsent output, until it catches up
+   constexpr size_t max_pending_output = 1024 * 1024;
+
+   std::atomic<bool> g_stop_requested{ false };
+
+   void OnStopSignal(int)
+   {
+      g_stop_requested = true;
+   }
+
+   struct ServerStats
+   {
+      std::atomic<uint64_t> connections{ 0 };
+      std::atomic<uint64_t> sessions_opened{ 0 };
+      std::atomic<uint64_t> swaps{ 0 };
+      std::atomic<int64_t> open_sessions{ 0 };
+      std::atomic<int64_t> peak_sessions{ 0 };
+   };
+
+   template <typename T>
+   void WriteValue(std::vector<uint8_t>& buffer, const T value)
+   {
+      const size_t offset = buffer.size();
+      buffer.resize(offset + sizeof(T));
+      memcpy(buffer.data() + offset, &value, sizeof(T));
+   }
+
+   template <typename T>
+   T ReadValue(const uint8_t*& data)
+   {
+      T value;
+      memcpy(&value, data, sizeof(T));
+      data += sizeof(T);
+      return value;
+   }
+
+   // Writes the length once the message is finished
+   class MessageWriter
+   {
+   public:
+      MessageWriter(std::vector<uint8_t>& buffer, const MessageType type) : buffer_(buffer), start_(buffer.size())
+      {
+         WriteValue<uint16_t>(buffer_, 0);
+         WriteValue<uint8_t>(buffer_, type);
+      }
+
+      ~MessageWriter()
+      {
+         const uint16_t length = static_cast<uint16_t>(buffer_.size() - start_ - sizeof(uint16_t));
+         memcpy(buffer_.data() + start_, &length, sizeof(uint16_t));
+      }
+
+      MessageWriter(const MessageWriter&) = delete;
+      MessageWriter& operator=(const MessageWriter&) = delete;
+
+   private:
+      std::vector<uint8_t>& buffer_;
+      size_t start_;
+   };
+
+   // Waiting for a move, Match3 only reports ready with a full board, but the step before a no-moves reset is ready too
+   bool IsSettled(const Match3& board)
+   {
+      return board.IsReadyForMove() && !board.g_extraInfo.next_frame_restarts;
+   }
+
+   void Settle(Match3& board)
+   {
+      for (int i = 0; i < max_settle_steps && !IsSettled(board); i++)
+         board.ProgressGame();
+   }
+
+   struct Connection
+   {
+      int fd = -1;
+      // Position in Worker::connections_, for removal
+      size_t index = 0;
+      std::vector<uint8_t> input;
+      std::vector<uint8_t> output;
+      size_t output_sent = 0;
+      uint32_t epoll_events = 0;
+      // Indexed by session id, null once closed. Closed ids are handed out again.
+      std::vector<std::unique_ptr<Match3>> sessions;
+      std::vector<uint32_t> free_session_ids;
+      size_t open_sessions = 0;
+   };
+
+   /// <summary> One thread's epoll loop. Accepts its own connections from the shared listening socket, and owns them and their sessions. </summary>
+   class Worker
+   {
+   public:
+      Worker(GameSettings* settings, const int listen_fd, ServerStats* stats, const int id)
+         : settings_(settings), listen_fd_(listen_fd), stats_(stats)
+      {
+         snprintf(name_, sizeof(name_), "Session Worker %i", id);
+      }
+
+      ~Worker()
+      {
+         for (Connection* connection : connections_)
+         {
+            stats_->open_sessions -= static_cast<int64_t>(connection->open_sessions);
+            close(connection->fd);
+            delete connection;
+         }
+         if (epoll_fd_ >= 0)
+            close(epoll_fd_);
+      }
+
+      Worker(const Worker&) = delete;
+      Worker& operator=(const Worker&) = delete;
+
+      bool Start()
+      {
+         epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+         if (epoll_fd_ < 0)
+         {
+            printf("epoll_create1 failed: %s\n", strerror(errno));
+            return false;
+         }
+         // Every worker waits on the listening socket, EPOLLEXCLUSIVE wakes just one of them per connection
+         epoll_event event{};
+         event.events = EPOLLIN | EPOLLEXCLUSIVE;
+         event.data.ptr = nullptr;
+         if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) != 0)
+         {
+            printf("Failed to watch the listening socket: %s\n", strerror(errno));
+            return false;
+         }
+         thread_ = std::thread(&Worker::Loop, this);
+         return true;
+      }
+
+      void Join()
+      {
+         if (thread_.joinable())
+            thread_.join();
+      }
+
+   private:
+      void Loop()
+      {
+         PROFILE_THREAD_NAME(name_);
+         epoll_event events[max_epoll_events];
+         while (!g_stop_requested)
+         {
+            const int count = epoll_wait(epoll_fd_, events, max_epoll_events, epoll_timeout);
+            for (int i = 0; i < count; i++)
+            {
+               Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+               if (!connection)
+               {
+                  AcceptConnections();
+                  continue;
+               }
+
+               bool isOpen = (events[i].events & (EPOLLERR | EPOLLHUP)) == 0;
+               if (isOpen && (events[i].events & EPOLLIN))
+                  isOpen = ReadMessages(*connection);
+               if (isOpen)
+                  isOpen = Flush(*connection);
+               if (isOpen)
+                  UpdateInterest(*connection);
+               else
+                  CloseConnection(connection);
+            }
+            PROFILE_END_FRAME();
+         }
+      }
+
+      void AcceptConnections()
+      {
+         while (true)
+         {
+            const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+               return;
+
+            // Harmless on Unix sockets, where it just fails
+            const int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            Connection* connection = new Connection();
+            connection->fd = fd;
+            connection->index = connections_.size();
+            connection->epoll_events = EPOLLIN;
+            epoll_event event{};
+            event.events = connection->epoll_events;
+            event.data.ptr = connection;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+            {
+               close(fd);
+               delete connection;
+               continue;
+            }
+            connections_.push_back(connection);
+            stats_->connections++;
+         }
+      }
+
+      void CloseConnection(Connection* connection)
+      {
+         epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection->fd, nullptr);
+         close(connection->fd);
+         stats_->open_sessions -= static_cast<int64_t>(connection->open_sessions);
+
+         connections_[connection->index] = connections_.back();
+         connections_[connection->index]->index = connection->index;
+         connections_.pop_back();
+         delete connection;
+      }
+
+      // Returns false if the connection should be closed
+      bool ReadMessages(Connection& connection)
+      {
+         uint8_t buffer[16 * 1024];
+         while (connection.output.size() - connection.output_sent < max_pending_output)
+         {
+            const ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (received == 0)
+               return false;
+            if (received < 0)
+               return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            connection.input.insert(connection.input.end(), buffer, buffer + received);
+
+            size_t offset = 0;
+            while (connection.input.size() - offset >= sizeof(uint16_t))
+            {
+               uint16_t length;
+               memcpy(&length, connection.input.data() + offset, sizeof(uint16_t));
+               if (length == 0)
+                  return false;
+               if (connection.input.size() - offset - sizeof(uint16_t) < length)
+                  break;
+               HandleMessage(connection, connection.input.data() + offset + sizeof(uint16_t), length);
+               offset += sizeof(uint16_t) + length;
+            }
+            connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+         }
+         return true;
+      }
+
+      // Returns false if the connection should be closed
+      bool Flush(Connection& connection)
+      {
+         while (connection.output_sent < connection.output.size())
+         {
+            const ssize_t sent = send(connection.fd, connection.output.data() + connection.output_sent, connection.output.size() - connection.output_sent, MSG_NOSIGNAL);
+            if (sent < 0)
+               return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            connection.output_sent += static_cast<size_t>(sent);
+         }
+         connection.output.clear();
+         connection.output_sent = 0;
+         return true;
+      }
+
+      // Waits for the socket to drain before reading more from a client that isn't keeping up with its replies
+      void UpdateInterest(Connection& connection)
+      {
+         const size_t pending = connection.output.size() - connection.output_sent;
+         const uint32_t wanted = (pending < max_pending_output ? static_cast<uint32_t>(EPOLLIN) : 0u) | (pending > 0 ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+         if (wanted == connection.epoll_events)
+            return;
+         epoll_event event{};
+         event.events = wanted;
+         event.data.ptr = &connection;
+         epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+         connection.epoll_events = wanted;
+      }
+
+      // Messages of an unknown type, or not the size their type says, are answered with BadMessage. The length still frames
+      // them so the connection carries on.
+      void HandleMessage(Connection& connection, const uint8_t* data, const size_t size)
+      {
+         const uint8_t type = *data++;
+         switch (type)
+         {
+         case Open:
+            if (size != 1 + 4 + 3)
+               break;
+            OpenSession(connection, data);
+            return;
+         case Swap:
+            if (size != 1 + 4 + 4)
+               break;
+            SwapCells(connection, data);
+            return;
+         case Close:
+         {
+            if (size != 1 + 4)
+               break;
+            const uint32_t sessionId = ReadValue<uint32_t>(data);
+            if (!FindSession(connection, sessionId))
+            {
+               WriteError(connection, Close, NoSuchSession);
+               return;
+            }
+            connection.sessions[sessionId].reset();
+            connection.free_session_ids.push_back(sessionId);
+            connection.open_sessions--;
+            stats_->open_sessions--;
+            return;
+         }
+         default:
+            break;
+         }
+         WriteError(connection, static_cast<MessageType>(type), BadMessage);
+      }
+
+      void OpenSession(Connection& connection, const uint8_t* data)
+      {
+         const uint32_t seed = ReadValue<uint32_t>(data);
+         const int width = ReadValue<uint8_t>(data);
+         const int height = ReadValue<uint8_t>(data);
+         const int cellTypes = ReadValue<uint8_t>(data);
+         // Fewer than 3 cell types never stops matching
+         if (width < 3 || height < 3 || width > max_board_size || height > max_board_size || cellTypes < 3 || cellTypes >= CELL_TYPE_COUNT)
+         {
+            WriteError(connection, Open, BadBoardSize);
+            return;
+         }
+         if (connection.open_sessions >= max_sessions_per_connection)
+         {
+            WriteError(connection, Open, TooManySessions);
+            return;
+         }
+
+         auto board = std::make_unique<Match3>(settings_);
+         board->g_print_ai_moves = false;
+         board->Reseed(seed != 0 ? seed : static_cast<Uint32>(stats_->sessions_opened.load() * 2654435761u + time(nullptr)));
+         board->GeneratePlayField(width, height, cellTypes);
+         Settle(*board);
+         board->ClearChangedCells();
+
+         uint32_t sessionId;
+         if (!connection.free_session_ids.empty())
+         {
+            sessionId = connection.free_session_ids.back();
+            connection.free_session_ids.pop_back();
+         }
+         else
+         {
+            sessionId = static_cast<uint32_t>(connection.sessions.size());
+            connection.sessions.emplace_back();
+         }
+
+         {
+            MessageWriter message(connection.output, Opened);
+            WriteValue<uint32_t>(connection.output, sessionId);
+            WriteValue<uint8_t>(connection.output, static_cast<uint8_t>(width));
+            WriteValue<uint8_t>(connection.output, static_cast<uint8_t>(height));
+            WriteValue<int32_t>(connection.output, board->g_extraInfo.game_score);
+            const int* cells = board->GetWorldData();
+            for (int i = 0; i < width * height; i++)
+               WriteValue<uint8_t>(connection.output, static_cast<uint8_t>(cells[i]));
+         }
+
+         connection.sessions[sessionId] = std::move(board);
+         connection.open_sessions++;
+         stats_->sessions_opened++;
+         const int64_t openSessions = ++stats_->open_sessions;
+         int64_t peak = stats_->peak_sessions.load();
+         while (openSessions > peak && !stats_->peak_sessions.compare_exchange_weak(peak, openSessions))
+         {
+         }
+      }
+
+      void SwapCells(Connection& connection, const uint8_t* data)
+      {
+         PROFILE_SCOPE("Session Swap");
+         const uint32_t sessionId = ReadValue<uint32_t>(data);
+         Match3* board = FindSession(connection, sessionId);
+         if (!board)
+         {
+            WriteError(connection, Swap, NoSuchSession);
+            return;
+         }
+         const int fromX = ReadValue<uint8_t>(data);
+         const int fromY = ReadValue<uint8_t>(data);
+         const int toX = ReadValue<uint8_t>(data);
+         const int toY = ReadValue<uint8_t>(data);
+         const IVec2 from(fromX, fromY);
+         const IVec2 to(toX, toY);
+         stats_->swaps++;
+
+         bool isAccepted;
+         {
+            PROFILE_SUSPEND();
+            board->ApplyCommand(Command::MakeSwap(from, to));
+            // A swap that made a match leaves the board settling
+            isAccepted = !board->IsReadyForMove();
+            if (isAccepted)
+               Settle(*board);
+         }
+
+         MessageWriter message(connection.output, Delta);
+         WriteValue<uint32_t>(connection.output, sessionId);
+         WriteValue<uint8_t>(connection.output, isAccepted ? 1 : 0);
+         WriteValue<int32_t>(connection.output, board->g_extraInfo.game_score);
+         const std::vector<int>& changedCells = board->GetChangedCells();
+         // A rejected swap swaps back, its cells end up as they were
+         WriteValue<uint16_t>(connection.output, static_cast<uint16_t>(isAccepted ? changedCells.size() : 0));
+         if (isAccepted)
+         {
+            const int* cells = board->GetWorldData();
+            for (const int index : changedCells)
+            {
+               WriteValue<uint16_t>(connection.output, static_cast<uint16_t>(index));
+               WriteValue<uint8_t>(connection.output, static_cast<uint8_t>(cells[index]));
+            }
+         }
+         board->ClearChangedCells();
+      }
+
+      static Match3* FindSession(Connection& connection, const uint32_t session_id)
+      {
+         return session_id < connection.sessions.size() ? connection.sessions[session_id].get() : nullptr;
+      }
+
+      static void WriteError(Connection& connection, const MessageType request, const ErrorCode code)
+      {
+         MessageWriter message(connection.output, Error);
+         WriteValue<uint8_t>(connection.output, request);
+         WriteValue<uint8_t>(connection.output, code);
+      }
+
+      GameSettings* settings_;
+      int listen_fd_;
+      ServerStats* stats_;
+      char name_[32];
+      int epoll_fd_ = -1;
+      std::thread thread_;
+      std::vector<Connection*> connections_;
+   };
+
+   // Binds "unix:path" or "tcp:port", returns the listening socket or -1
+   int Listen(const std::string& address)
+   {
+      int fd = -1;
+      if (address.compare(0, 5, "unix:") == 0)
+      {
+         const std::string path = address.substr(5);
+         sockaddr_un socketAddress{};
+         if (path.empty() || path.size() >= sizeof(socketAddress.sun_path))
+         {
+            printf("Unix socket path '%s' is empty or too long\n", path.c_str());
+            return -1;
+         }
+         socketAddress.sun_family = AF_UNIX;
+         memcpy(socketAddress.sun_path, path.c_str(), path.size());
+         // A socket left behind by a previous run would stop us binding, anything else at the path is left for bind to report
+         struct stat existing;
+         if (lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+            unlink(path.c_str());
+         fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+         if (fd >= 0 && bind(fd, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0)
+         {
+            printf("Failed to bind %s: %s\n", path.c_str(), strerror(errno));
+            close(fd);
+            return -1;
+         }
+      }
+      else if (address.compare(0, 4, "tcp:") == 0)
+      {
+         const int port = atoi(address.c_str() + 4);
+         if (port <= 0 || port > 0xFFFF)
+         {
+            printf("Bad port in '%s'\n", address.c_str());
+            return -1;
+         }
+         sockaddr_in socketAddress{};
+         socketAddress.sin_family = AF_INET;
+         socketAddress.sin_port = htons(static_cast<uint16_t>(port));
+         // Only local clients, this is for our own bots and load tests
+         socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+         fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+         const int reuse = 1;
+         if (fd >= 0)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+         if (fd >= 0 && bind(fd, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0)
+         {
+            printf("Failed to bind port %i: %s\n", port, strerror(errno));
+            close(fd);
+            return -1;
+         }
+      }
+      else
+      {
+         printf("Serve address '%s' should be unix:path or tcp:port\n", address.c_str());
+         return -1;
+      }
+
+      if (fd < 0 || listen(fd, SOMAXCONN) != 0)
+      {
+         printf("Failed to listen on %s: %s\n", address.c_str(), strerror(errno));
+         if (fd >= 0)
+            close(fd);
+         return -1;
+      }
+      return fd;
+   }
+}
+
+int SessionServer::Run(GameSettings* settings)
+{
+   const int listenFd = Listen(settings->serve_address);
+   if (listenFd < 0)
+      return 1;
+
+   signal(SIGINT, OnStopSignal);
+   signal(SIGTERM, OnStopSignal);
+
+   int threadCount = settings->server_threads;
+   if (threadCount <= 0)
+      threadCount = static_cast<int>(std::min(4u, std::max(1u, std::thread::hardware_concurrency())));
+
+   ServerStats stats;
+   std::vector<std::unique_ptr<Worker>> workers;
+   bool isStarted = true;
+   for (int i = 0; i < threadCount && isStarted; i++)
+   {
+      workers.push_back(std::make_unique<Worker>(settings, listenFd, &stats, i));
+      isStarted = workers.back()->Start();
+   }
+   if (isStarted)
+      printf("Session server listening on %s with %i threads, Ctrl+C to stop\n", settings->serve_address.c_str(), threadCount);
+   else
+      // Stops the workers that did start
+      g_stop_requested = true;
+
+   for (auto& worker : workers)
+      worker->Join();
+   workers.clear();
+   close(listenFd);
+   if (settings->serve_address.compare(0, 5, "unix:") == 0)
+      unlink(settings->serve_address.c_str() + 5);
+
+   printf("Session server: %llu connections, %llu sessions opened (%lld open at once at most), %llu swaps\n",
+          static_cast<unsigned long long>(stats.connections.load()), static_cast<unsigned long long>(stats.sessions_opened.load()),
+          static_cast<long long>(stats.peak_sessions.load()), static_cast<unsigned long long>(stats.swaps.load()));
+   return isStarted ? 0 : 1;
+}
+
+#else
+
+int SessionServer::Run(GameSettings* settings)
+{
+   printf("The session server is only supported on Linux\n");
+   return 1;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+
+#include "GameSettings.h"
+
+/// <summary>
+/// Binary protocol spoken by the session server, little endian. Every message is a uint16 length followed by that many bytes,
+/// the first of which is the message type.
+///   Client -> Server
+///     Open   - uint32 seed (0 picks one), uint8 width, uint8 height, uint8 cell types
+///     Swap   - uint32 session, uint8 from x, from y, to x, to y
+///     Close  - uint32 session
+///   Server -> Client
+///     Opened - uint32 session, uint8 width, uint8 height, int32 score, then width * height uint8 cells
+///     Delta  - uint32 session, uint8 accepted, int32 score, uint16 count, then count * (uint16 cell index, uint8 cell)
+///     Error  - uint8 request type, uint8 ErrorCode
+/// A swap is played out until the board is waiting for the next move, the Delta carries every cell that changed on the way.
+/// Swaps that don't make a match are answered with accepted 0 and no cells, like Match3::Step rejecting them.
+/// </summary>
+namespace SessionProtocol
+{
+   constexpr int max_message_size = 0xFFFF;
+   constexpr int max_board_size = 64;
+
+   enum MessageType : uint8_t
+   {
+      Open = 1,
+      Swap = 2,
+      Close = 3,
+
+      Opened = 0x81,
+      Delta = 0x82,
+      Error = 0xFF
+   };
+
+   enum ErrorCode : uint8_t
+   {
+      BadMessage = 1,
+      NoSuchSession = 2,
+      BadBoardSize = 3,
+      TooManySessions = 4
+   };
+}
+
+/// <summary>
+/// Headless server for bots and load tests, clients connect over a Unix domain socket or localhost TCP and play sessions,
+/// each with its own board. Connections are spread over a few threads each running its own epoll loop, a connection and
+/// its sessions only ever live on one thread so nothing is shared or locked. Linux only.
+/// </summary>
+class SessionServer
+{
+public:
+   /// <summary> Server mode entry point, serves settings->serve_address until interrupted. Returns the process exit code. </summary>
+   static int Run(GameSettings* settings);
+};
@@ -1,7 +1,47 @@
 #include "ShaderManager.h"
 
+#include <cstring>
+#include <fstream>
+
 ShaderManager* ShaderManager::instance_ = nullptr;
 
+namespace
+{
+   // Bump when the cache file layout changes
+   const char program_cache_magic[4] = { 'M', '3', 'P', 'C' };
+   constexpr uint32_t program_cache_version = 1;
+
+   // FNV-1a, only used to tell whether the sources or driver changed
+   uint64_t HashBytes(uint64_t hash, const void* data, const size_t size)
+   {
+      const auto* bytes = static_cast<const uint8_t*>(data);
+      for (size_t i = 0; i < size; i++)
+      {
+         hash ^= bytes[i];
+         hash *= 1099511628211ull;
+      }
+      return hash;
+   }
+
+   uint64_t HashString(const uint64_t hash, const char* text)
+   {
+      // Hash the terminator too, so "ab" + "c" isn't the same as "a" + "bc"
+      return text ? HashBytes(hash, text, strlen(text) + 1) : HashBytes(hash, "", 1);
+   }
+
+   template <typename T>
+   bool ReadRaw(std::ifstream& file, T& value)
+   {
+      return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+   }
+
+   template <typename T>
+   void WriteRaw(std::ofstream& file, const T& value)
+   {
+      file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+   }
+}
+
 ShaderManager::ShaderManager() = default;
 
 ShaderManager* ShaderManager::Instance()
@@ -13,19 +53,101 @@ ShaderManager* ShaderManager::Instance()
 
 int ShaderManager::CreateShaderProgram(const char* shader_name, bool delete_sources)
 {
+   const GLint program = SubmitShaderProgram(shader_name, delete_sources);
+   if (program == -1)
+      return -1;
+
+   for (size_t i = 0; i < pending_programs_.size(); i++)
+   {
+      if (pending_programs_[i].program == static_cast<GLuint>(program))
+      {
+         const PendingProgram pending = pending_programs_[i];
+         pending_programs_.erase(pending_programs_.begin() + i);
+         return FinishProgram(pending) ? program : -1;
+      }
+   }
+   // Loaded from the cache, nothing to wait for
+   return program;
+}
+
+GLint ShaderManager::SubmitShaderProgram(const char* shader_name, bool delete_sources)
+{
+   EnableParallelCompile();
+
+   PendingProgram pending{ shader_name, 0, delete_sources, false, 0, {}, {} };
+   const auto sources = shader_sources_.find(shader_name);
+   if (sources != shader_sources_.end())
+   {
+      pending.is_cacheable = IsProgramCacheSupported();
+      if (pending.is_cacheable)
+      {
+         pending.cache_key = GetProgramCacheKey(shader_name);
+         const GLuint cached = LoadCachedProgram(shader_name, pending.cache_key);
+         if (cached != 0)
+         {
+            shader_sources_.erase(sources);
+            program_cache_hits_++;
+            printf("Shader Program '%s' Loaded from the program cache\n", shader_name);
+            program_id_[shader_name] = cached;
+            program_name_[cached] = shader_name;
+            return cached;
+         }
+      }
+
+      // Cache miss, start compiling everything that was added
+      program_cache_misses_++;
+      // Same order as GetShaderIndex
+      const GLint types[shader_types_count] = { Vertex, Fragment, Geometry, TessellationEval, TessellationControl, Compute };
+      for (int i = 0; i < shader_types_count; i++)
+      {
+         ShaderSource& source = sources->second[i];
+         if (!source.code.empty())
+         {
+            SubmitShaderSource(shader_name, types[i], source.code);
+            pending.paths[i] = std::move(source.path);
+         }
+      }
+      shader_sources_.erase(sources);
+   }
+
    GLuint program = glCreateProgram();
    auto shaderArray = shader_map_[shader_name];
-   int shaders_added = 0;
    for (int i = 0; i < shader_types_count; i++)
    {
+      pending.shaders[i] = shaderArray[i];
       if (shaderArray[i] != 0)
-      {
          glAttachShader(program, shaderArray[i]);
+   }
+   // Has to be set before linking for the driver to keep the binary around
+   if (pending.is_cacheable)
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+   // Link our program, the status is checked once it is needed
+   glLinkProgram(program);
+
+   pending.program = program;
+   program_id_[shader_name] = program;
+   program_name_[program] = shader_name;
+   pending_programs_.push_back(std::move(pending));
+   return program;
+}
+
+bool ShaderManager::FinishProgram(const PendingProgram& pending)
+{
+   const char* shader_name = pending.name;
+   int shaders_added = 0;
+   bool isCompiled = true;
+   for (int i = 0; i < shader_types_count; i++)
+   {
+      if (pending.shaders[i] != 0)
+      {
          shaders_added++;
+         // Shaders compiled with CompileShader have already been checked
+         if (!pending.paths[i].empty() && !CheckShader(pending.shaders[i], pending.paths[i]))
+            isCompiled = false;
       }
    }
-   // Link our program
-   glLinkProgram(program);
+
+   GLuint program = pending.program;
    GLint isLinked = 0;
    glGetProgramiv(program, GL_LINK_STATUS, (int*)&isLinked);
    if (isLinked == GL_FALSE)
@@ -34,41 +156,117 @@ int ShaderManager::CreateShaderProgram(const char* shader_name, bool delete_sour
       glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
 
       // The maxLength includes the NULL character
-      std::vector<GLchar> infoLog(maxLength);
-      glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+      if (isCompiled && maxLength > 0)
+      {
+         std::vector<GLchar> infoLog(maxLength);
+         glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+         printf("Shader Program '%s' failed to link: %s\n", shader_name, infoLog.data());
+      }
 
       // Clear Program, and shaders if we're doing that here.
       glDeleteProgram(program);
-      //TODO Tidy this with below #1
-      if (delete_sources)
+      program_id_.erase(shader_name);
+      program_name_.erase(program);
+      failed_programs_.push_back(program);
+      if (pending.delete_sources)
+         DeleteShaders(shader_name);
+      return false;
+   }
+   printf("Shader Program '%s' Generated using %i modules\n", shader_name, shaders_added);
+   if (pending.delete_sources)
+      DeleteShaders(shader_name);
+
+   if (pending.is_cacheable)
+      SaveCachedProgram(shader_name, pending.cache_key, program);
+   return true;
+}
+
+bool ShaderManager::IsProgramComplete(const GLuint program) const
+{
+   // Without the extension any status query waits for the compile, so there's nothing to gain by checking first
+   if (!is_parallel_compile_)
+      return true;
+   GLint isComplete = GL_FALSE;
+   glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &isComplete);
+   return isComplete == GL_TRUE;
+}
+
+bool ShaderManager::IsProgramReady(const GLint program)
+{
+   for (size_t i = 0; i < pending_programs_.size(); i++)
+   {
+      if (pending_programs_[i].program != static_cast<GLuint>(program))
+         continue;
+      if (!IsProgramComplete(program))
+         return false;
+      const PendingProgram pending = pending_programs_[i];
+      pending_programs_.erase(pending_programs_.begin() + i);
+      return FinishProgram(pending);
+   }
+   for (auto failed : failed_programs_)
+   {
+      if (failed == static_cast<GLuint>(program))
+         return false;
+   }
+   return program > 0;
+}
+
+int ShaderManager::PollPrograms()
+{
+   for (size_t i = 0; i < pending_programs_.size();)
+   {
+      if (IsProgramComplete(pending_programs_[i].program))
       {
-         for (int i = 0; i < shader_types_count; i++)
-         {
-            if (shaderArray[i] != 0)
-            {
-               glDeleteShader(shaderArray[i]);
-            }
-         }
-         shader_map_.erase(shader_name);
+         const PendingProgram pending = pending_programs_[i];
+         pending_programs_.erase(pending_programs_.begin() + i);
+         FinishProgram(pending);
       }
-      return - 1;
+      else
+         i++;
    }
-   printf("Shader Program '%s' Generated using %i modules\n", shader_name, shaders_added);
-   program_id_[shader_name] = program;
-   program_name_[program] = shader_name;
-   //TODO Tidy this with above #1
-   if (delete_sources)
+   return static_cast<int>(pending_programs_.size());
+}
+
+bool ShaderManager::FinishPrograms()
+{
+   bool isAllLinked = true;
+   for (const auto& pending : pending_programs_)
+      isAllLinked &= FinishProgram(pending);
+   pending_programs_.clear();
+   return isAllLinked;
+}
+
+void ShaderManager::EnableParallelCompile()
+{
+   if (is_parallel_compile_checked_)
+      return;
+   is_parallel_compile_checked_ = true;
+
+   // Let the driver use as many threads as it likes
+   if (GLEW_KHR_parallel_shader_compile)
+   {
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+      is_parallel_compile_ = true;
+   }
+   else if (GLEW_ARB_parallel_shader_compile)
+   {
+      glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+      is_parallel_compile_ = true;
+   }
+   printf("Parallel shader compile %s\n", is_parallel_compile_ ? "enabled" : "not supported, programs are checked when first used");
+}
+
+void ShaderManager::DeleteShaders(const char* shader_name)
+{
+   auto shaderArray = shader_map_[shader_name];
+   for (int i = 0; i < shader_types_count; i++)
+   {
+      if (shaderArray[i] != 0)
       {
-         for (int i = 0; i < shader_types_count; i++)
-         {
-            if (shaderArray[i] != 0)
-            {
-               glDeleteShader(shaderArray[i]);
-            }
-         }
-         shader_map_.erase(shader_name);
+         glDeleteShader(shaderArray[i]);
       }
-   return program;
+   }
+   shader_map_.erase(shader_name);
 }
 
 GLint ShaderManager::GetProgramID(const char* program_name)
@@ -95,18 +293,41 @@ bool ShaderManager::CompileShader(const char* shader_name, const int shader_type
    return CompileShader(shader_name, shader_type, std::string(path));
 }
 bool ShaderManager::CompileShader(const char* shader_name, const int shader_type, const std::string path)
+{
+   // Get Shader Code so we can compile it
+   return CompileShaderSource(shader_name, shader_type, IO::get_file_contents(path), path);
+}
+
+bool ShaderManager::AddShaderSource(const char* shader_name, const int shader_type, const std::string& path)
+{
+   const int index = GetShaderIndex(shader_type);
+   std::string shaderCode = IO::get_file_contents(path);
+   if (index == -1 || shaderCode.empty())
+   {
+      printf("Shader source missing!\nSource: %s\n", path.c_str());
+      return false;
+   }
+   shader_sources_[shader_name][index] = { std::move(shaderCode), path };
+   return true;
+}
+
+GLuint ShaderManager::SubmitShaderSource(const char* shader_name, const int shader_type, const std::string& source)
 {
    GLuint shader = glCreateShader(shader_type);
-   if (0 == shader_type) {
+   if (0 == shader) {
       std::printf("Error creating shader.\n");
-      return false;
+      return 0;
    }
-   // Get Shader Code so we can compile it
-   const std::string shaderCode = IO::get_file_contents(path);
-   const GLchar* codeArray[] = { shaderCode.c_str() };
+   const GLchar* codeArray[] = { source.c_str() };
    glShaderSource(shader, 1, codeArray, nullptr);
    // Compile
    glCompileShader( shader );
+   shader_map_[shader_name][GetShaderIndex(shader_type)] = shader;
+   return shader;
+}
+
+bool ShaderManager::CheckShader(const GLuint shader, const std::string& path)
+{
    // Check to confirm
    GLint result;
    glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
@@ -121,13 +342,118 @@ bool ShaderManager::CompileShader(const char* shader_name, const int shader_type
          glGetShaderInfoLog(shader, logLen, &written, &log[0]);
          printf("Shader log: %s", log.c_str());
       }
+      return false;
+   }
+   return true;
+}
+
+bool ShaderManager::CompileShaderSource(const char* shader_name, const int shader_type, const std::string& source, const std::string& path)
+{
+   const GLuint shader = SubmitShaderSource(shader_name, shader_type, source);
+   if (shader == 0)
+      return false;
+   if (!CheckShader(shader, path))
+   {
       glDeleteShader(shader);
+      shader_map_[shader_name][GetShaderIndex(shader_type)] = 0;
+      return false;
    }
-   else
+   return true;
+}
+
+bool ShaderManager::IsProgramCacheSupported() const
+{
+   if (glGetProgramBinary == nullptr || glProgramBinary == nullptr || glProgramParameteri == nullptr)
+      return false;
+   // Some drivers expose the functions but have no binary formats to give out
+   GLint formats = 0;
+   glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+   return formats > 0;
+}
+
+uint64_t ShaderManager::GetProgramCacheKey(const char* shader_name) const
+{
+   // Binaries are only valid for the driver that made them, a driver update has to miss
+   uint64_t hash = 14695981039346656037ull;
+   hash = HashString(hash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+   hash = HashString(hash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+   hash = HashString(hash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+   const auto& sources = shader_sources_.at(shader_name);
+   for (int i = 0; i < shader_types_count; i++)
    {
-      shader_map_[shader_name][GetShaderIndex(shader_type)] = shader;
+      hash = HashBytes(hash, &i, sizeof(i));
+      hash = HashString(hash, sources[i].code.c_str());
+   }
+   return hash;
+}
 
-      return true;
+std::string ShaderManager::GetProgramCachePath(const char* shader_name)
+{
+   return ((IO::get_data_path() / "shader_cache") / (std::string(shader_name) + ".bin")).string();
+}
+
+// Cache file: magic, version, key, binary format, binary length, binary
+GLuint ShaderManager::LoadCachedProgram(const char* shader_name, const uint64_t key) const
+{
+   std::ifstream file(GetProgramCachePath(shader_name), std::ios::binary);
+   if (!file.is_open())
+      return 0;
+
+   char magic[4];
+   uint32_t version = 0;
+   uint64_t fileKey = 0;
+   GLenum format = 0;
+   uint32_t length = 0;
+   std::vector<uint8_t> binary;
+   bool isValid = file.read(magic, 4) && memcmp(magic, program_cache_magic, 4) == 0 &&
+                  ReadRaw(file, version) && version == program_cache_version &&
+                  ReadRaw(file, fileKey) && fileKey == key &&
+                  ReadRaw(file, format) &&
+                  ReadRaw(file, length) && length > 0;
+   if (isValid)
+   {
+      binary.resize(length);
+      isValid = static_cast<bool>(file.read(reinterpret_cast<char*>(binary.data()), length));
    }
-   return false;
+   if (!isValid)
+      return 0;
+
+   GLuint program = glCreateProgram();
+   glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(length));
+   GLint isLinked = 0;
+   glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+   if (isLinked == GL_FALSE)
+   {
+      // The driver can still refuse a binary it made, it gets compiled and replaced instead
+      glDeleteProgram(program);
+      return 0;
+   }
+   return program;
+}
+
+void ShaderManager::SaveCachedProgram(const char* shader_name, const uint64_t key, const GLuint program) const
+{
+   GLint length = 0;
+   glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+   if (length <= 0)
+      return;
+
+   std::vector<uint8_t> binary(length);
+   GLenum format = 0;
+   glGetProgramBinary(program, length, &length, &format, binary.data());
+
+   const std::string path = GetProgramCachePath(shader_name);
+   std::error_code error;
+   std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+   std::ofstream file(path, std::ios::binary);
+   const uint32_t binaryLength = static_cast<uint32_t>(length);
+   file.write(program_cache_magic, 4);
+   WriteRaw(file, program_cache_version);
+   WriteRaw(file, key);
+   WriteRaw(file, format);
+   WriteRaw(file, binaryLength);
+   file.write(reinterpret_cast<const char*>(binary.data()), binaryLength);
+   if (!file)
+      printf("Failed to write the program cache %s\n", path.c_str());
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include <GL/glew.h>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "IO.h"
 
 //TODO Way to combine shaders of different names.
@@ -17,6 +19,30 @@ public:
    bool CompileShader(const char* shader_name, const int shader_type, const std::string path);
    bool CompileShader(const char* shader_name, const int shader_type, const char* path);
 
+   /// <summary>
+   /// Reads a shader's source without compiling it, CreateShaderProgram then loads the program from the on-disk cache
+   /// when the sources and driver match the cached binary, and only compiles on a miss.
+   /// </summary>
+   bool AddShaderSource(const char* shader_name, const int shader_type, const std::string& path);
+
+   /// <summary>
+   /// Batch version of CreateShaderProgram. Starts compiling and linking without checking any status, so a whole batch
+   /// of programs can be submitted before any of them are waited on. With KHR_parallel_shader_compile the driver
+   /// compiles them on its own threads, IsProgramReady then tells whether one can be used yet without blocking.
+   /// </summary>
+   GLint SubmitShaderProgram(const char* shader_name, bool delete_sources = true);
+   // False while the program is still compiling, or if it failed to link. Never blocks when parallel compile is supported.
+   bool IsProgramReady(GLint program);
+   // Checks every submitted program that has finished, returns how many are still compiling
+   int PollPrograms();
+   // Waits for every submitted program, returns false if any failed
+   bool FinishPrograms();
+   bool IsParallelCompileSupported() const { return is_parallel_compile_; }
+
+   // Programs loaded from the cache and compiled this run
+   int GetProgramCacheHits() const { return program_cache_hits_; }
+   int GetProgramCacheMisses() const { return program_cache_misses_; }
+
    GLint GetProgramID(const char* program_name);
    const char* GetProgramName(const GLint program_id);
 
@@ -58,12 +84,58 @@ private:
       return -1;
    }
 
+   // Starts compiling, the result is only checked by CheckShader
+   GLuint SubmitShaderSource(const char* shader_name, const int shader_type, const std::string& source);
+   bool CheckShader(GLuint shader, const std::string& path);
+   bool CompileShaderSource(const char* shader_name, const int shader_type, const std::string& source, const std::string& path);
+   void DeleteShaders(const char* shader_name);
+
+   // Programs submitted but not yet checked
+   struct PendingProgram
+   {
+      const char* name;
+      GLuint program;
+      bool delete_sources;
+      bool is_cacheable;
+      uint64_t cache_key;
+      GLuint shaders[shader_types_count];
+      std::string paths[shader_types_count];
+   };
+   // Checks the pending program's compile and link status, saving it to the cache or cleaning up. Blocks if it hasn't finished.
+   bool FinishProgram(const PendingProgram& pending);
+   bool IsProgramComplete(GLuint program) const;
+   void EnableParallelCompile();
+
+   // Hash of every source added for the program and the driver that compiles it
+   uint64_t GetProgramCacheKey(const char* shader_name) const;
+   static std::string GetProgramCachePath(const char* shader_name);
+   bool IsProgramCacheSupported() const;
+   // Returns the loaded program, or 0 if there is no cached binary for this key or the driver rejects it
+   GLuint LoadCachedProgram(const char* shader_name, uint64_t key) const;
+   void SaveCachedProgram(const char* shader_name, uint64_t key, GLuint program) const;
+
    std::unordered_map<const char*, GLint> program_id_;
    std::unordered_map<GLint, const char*> program_name_;
 
    // Used to simplify 
    std::unordered_map<const char*, int[shader_types_count]> shader_map_;
 
+   // Sources added with AddShaderSource, waiting for CreateShaderProgram
+   struct ShaderSource
+   {
+      std::string code;
+      std::string path;
+   };
+   std::unordered_map<const char*, ShaderSource[shader_types_count]> shader_sources_;
+
+   int program_cache_hits_ = 0;
+   int program_cache_misses_ = 0;
+
+   std::vector<PendingProgram> pending_programs_;
+   std::vector<GLuint> failed_programs_;
+   bool is_parallel_compile_ = false;
+   bool is_parallel_compile_checked_ = false;
+
    static ShaderManager* instance_;
 };
 
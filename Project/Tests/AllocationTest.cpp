@@ -0,0 +1,72 @@
+#include <cstdio>
+
+#include "Match3.h"
+#include "AllocationCounter.h"
+#include "BoardSnapshot.h"
+#include "Profiler.h"
+#include "TripleBuffer.h"
+
+/// <summary>
+/// Steady state allocation test, run by ctest. Plays a seeded board with the first legal move whenever it is ready,
+/// publishing a snapshot every fixed step the way the simulation thread does, and fails if any step after the warmup allocates.
+/// </summary>
+namespace
+{
+   constexpr int warmup_steps = 500;
+   constexpr int measured_steps = 20000;
+
+   int moves_played = 0;
+
+   void RunStep(Match3& match3, TripleBuffer<BoardSnapshot>& snapshots, Uint32& sequence)
+   {
+      IVec2 move[2];
+      if (match3.IsReadyForMove() && match3.AnyLegalMatchesExist(move))
+      {
+         match3.ApplyCommand(Command::MakeSwap(move[Match3::CellMove::FROM], move[Match3::CellMove::TO]));
+         moves_played++;
+      }
+      match3.FixedUpdate();
+
+      snapshots.WriteBuffer().Capture(match3, ++sequence);
+      match3.ClearChangedCells();
+      snapshots.Publish();
+      snapshots.Consume();
+      PROFILE_END_FRAME();
+   }
+}
+
+int main()
+{
+   GameSettings settings;
+   settings.random_seed = 5;
+   settings.world_size = IVec2(16, 16);
+
+   Match3 match3(&settings);
+   match3.g_print_ai_moves = false;
+   match3.GeneratePlayField(settings.world_size.x, settings.world_size.y, settings.cell_types_used);
+
+   TripleBuffer<BoardSnapshot> snapshots;
+   Uint32 sequence = 0;
+   for (int i = 0; i < warmup_steps; i++)
+      RunStep(match3, snapshots, sequence);
+
+   const int warmupMoves = moves_played;
+   const ScopedAllocationCount allocations;
+   for (int i = 0; i < measured_steps; i++)
+      RunStep(match3, snapshots, sequence);
+   const uint64_t count = allocations.Count();
+
+   const int measuredMoves = moves_played - warmupMoves;
+   printf("AllocationTest: %i steps, %i moves, %llu allocations\n", measured_steps, measuredMoves, static_cast<unsigned long long>(count));
+   if (measuredMoves == 0)
+   {
+      printf("AllocationTest failed: no moves were played, the board never changed\n");
+      return 1;
+   }
+   if (count > 0)
+   {
+      printf("AllocationTest failed: steady state fixed steps and snapshot publishing should never allocate\n");
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,96 @@
+#include <cstdio>
+
+#include "Match3.h"
+
+/// <summary>
+/// Auto-play test, run by ctest. Plays seeded boards with the first legal move whenever they are ready, the same as the Player
+/// on auto-play, and fails if a board stops taking moves. Small boards with many cell types run out of moves often, so every
+/// board goes through several no-moves resets, and a Reset command is sent partway through each game too.
+/// </summary>
+namespace
+{
+   struct Case
+   {
+      int width;
+      int height;
+      int cell_types;
+   };
+
+   constexpr Case cases[] = { { 8, 8, 5 }, { 6, 6, 6 }, { 5, 5, 7 } };
+   constexpr int seeds_per_case = 30;
+   constexpr int steps_per_game = 36000;
+   constexpr int reset_command_step = steps_per_game / 2;
+   // Far longer than any cascade, a board that goes this long without accepting a move has frozen
+   constexpr int max_steps_between_moves = 2000;
+
+   // Returns the number of no-moves resets played through, or -1 if the board froze
+   int PlayGame(const Case& game, const Uint32 seed)
+   {
+      GameSettings settings;
+      settings.random_seed = seed;
+      settings.world_size = IVec2(game.width, game.height);
+      settings.cell_types_used = game.cell_types;
+
+      Match3 match3(&settings);
+      match3.g_print_ai_moves = false;
+      match3.GeneratePlayField(game.width, game.height, game.cell_types);
+
+      int resets = 0;
+      int lastMoveStep = 0;
+      bool wasRestarting = false;
+      for (int step = 0; step < steps_per_game; step++)
+      {
+         if (step == reset_command_step)
+            match3.ApplyCommand(Command::Make(Command::Reset));
+
+         IVec2 move[2];
+         if (match3.IsReadyForMove() && match3.AnyLegalMatchesExist(move))
+         {
+            match3.ApplyCommand(Command::MakeSwap(move[Match3::CellMove::FROM], move[Match3::CellMove::TO]));
+            // An accepted move leaves the board settling
+            if (!match3.IsReadyForMove())
+               lastMoveStep = step;
+         }
+         match3.FixedUpdate();
+
+         // The board shows it is about to restart for a step before it resets
+         if (wasRestarting && !match3.g_extraInfo.next_frame_restarts)
+            resets++;
+         wasRestarting = match3.g_extraInfo.next_frame_restarts;
+
+         if (step - lastMoveStep > max_steps_between_moves)
+         {
+            printf("AutoPlayTest failed: %ix%i with %i types, seed %u stopped taking moves at step %i after %i resets\n",
+                   game.width, game.height, game.cell_types, seed, lastMoveStep, resets);
+            return -1;
+         }
+      }
+      return resets;
+   }
+}
+
+int main()
+{
+   int failures = 0;
+   int totalResets = 0;
+   for (const Case& game : cases)
+   {
+      for (Uint32 seed = 1; seed <= seeds_per_case; seed++)
+      {
+         const int resets = PlayGame(game, seed);
+         if (resets < 0)
+            failures++;
+         else
+            totalResets += resets;
+      }
+   }
+
+   printf("AutoPlayTest: %i games, %i no-moves resets played through, %i froze\n", seeds_per_case * static_cast<int>(sizeof(cases) / sizeof(cases[0])),
+          totalResets, failures);
+   if (totalResets == 0)
+   {
+      printf("AutoPlayTest failed: no board ran out of moves, the resets weren't tested\n");
+      return 1;
+   }
+   return failures > 0 ? 1 : 0;
+}
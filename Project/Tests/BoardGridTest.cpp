@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <vector>
+
+#include "Match3.h"
+#include "BoardGrid.h"
+
+/// <summary>
+/// Monitor grid test, run by ctest. Runs a grid of small boards the way turbo batch runs do, with and without lookahead, and
+/// fails if any board the grid plays stops changing. Small boards with many cell types run out of moves often, so every board
+/// goes through several no-moves resets while the grid is applying moves to it every fixed step.
+/// </summary>
+namespace
+{
+   constexpr int board_size = 6;
+   constexpr int cell_types = 6;
+   constexpr int monitor_boards = 9;
+   constexpr int steps_per_run = 20000;
+   // Far longer than any cascade or wait for a search turn, a board that goes this long without changing has frozen
+   constexpr int max_unchanged_steps = 2000;
+
+   // Returns the number of no-moves resets played through, or -1 if a board froze
+   int RunGrid(const int search_depth, const Uint32 seed)
+   {
+      GameSettings settings;
+      settings.random_seed = seed;
+      settings.world_size = IVec2(board_size, board_size);
+      settings.cell_types_used = cell_types;
+      settings.monitor_boards = monitor_boards;
+      settings.ai_search_depth = search_depth;
+
+      // The game's board, played here the same as the Player on auto-play
+      Match3 first(&settings);
+      first.g_print_ai_moves = false;
+      first.GeneratePlayField(board_size, board_size, cell_types);
+      BoardGrid grid(&settings, &first);
+      grid.Start();
+
+      std::vector<Uint32> versions(grid.BoardCount(), 0);
+      std::vector<int> lastChangeSteps(grid.BoardCount(), 0);
+      std::vector<bool> wasRestarting(grid.BoardCount(), false);
+      int resets = 0;
+      for (int step = 0; step < steps_per_run; step++)
+      {
+         IVec2 move[2];
+         if (first.IsReadyForMove() && first.AnyLegalMatchesExist(move))
+            first.ApplyCommand(Command::MakeSwap(move[Match3::CellMove::FROM], move[Match3::CellMove::TO]));
+         first.FixedUpdate();
+         grid.FixedUpdate();
+
+         for (int i = 0; i < grid.BoardCount(); i++)
+         {
+            const Match3& board = grid.GetBoard(i);
+            if (board.GetBoardVersion() != versions[i])
+            {
+               versions[i] = board.GetBoardVersion();
+               lastChangeSteps[i] = step;
+            }
+            // The board shows it is about to restart for a step before it resets
+            if (wasRestarting[i] && !board.g_extraInfo.next_frame_restarts)
+               resets++;
+            wasRestarting[i] = board.g_extraInfo.next_frame_restarts;
+
+            if (step - lastChangeSteps[i] > max_unchanged_steps)
+            {
+               printf("BoardGridTest failed: depth %i, seed %u, board %i stopped changing at step %i\n", search_depth, seed, i, lastChangeSteps[i]);
+               return -1;
+            }
+         }
+      }
+      return resets;
+   }
+}
+
+int main()
+{
+   int failures = 0;
+   int totalResets = 0;
+   for (int depth = 0; depth <= 1; depth++)
+   {
+      for (Uint32 seed = 1; seed <= 4; seed++)
+      {
+         const int resets = RunGrid(depth, seed);
+         if (resets < 0)
+            failures++;
+         else
+            totalResets += resets;
+      }
+   }
+
+   printf("BoardGridTest: %i no-moves resets played through, %i runs froze\n", totalResets, failures);
+   if (totalResets == 0)
+   {
+      printf("BoardGridTest failed: no board ran out of moves, the resets weren't tested\n");
+      return 1;
+   }
+   return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct TraceEvent
+{
+   const char* name;
+   // Milliseconds on the profiler clock
+   double start;
+   // Negative for an instant event
+   double duration;
+   char detail[24];
+};
+
+/// <summary>
+/// Ring of the most recent trace events, written by one thread and read by any other without locking.
+/// Once full the oldest events are overwritten, the reader drops anything that may have been overwritten while it copied.
+/// </summary>
+class TraceBuffer
+{
+public:
+   static constexpr uint32_t capacity = 1 << 16;
+
+   TraceBuffer() : events_(new TraceEvent[capacity]) {}
+
+   // Writer thread only
+   void Push(const TraceEvent& trace_event)
+   {
+      const uint64_t index = write_count_.load(std::memory_order_relaxed);
+      // The last count is published before this slot is overwritten, a reader that sees part of the new event sees the count too
+      std::atomic_thread_fence(std::memory_order_release);
+      events_[index & (capacity - 1)] = trace_event;
+      write_count_.store(index + 1, std::memory_order_release);
+   }
+
+   // Any thread, appends everything still in the buffer oldest first
+   void CopyTo(std::vector<TraceEvent>& out) const
+   {
+      const uint64_t end = write_count_.load(std::memory_order_acquire);
+      const uint64_t begin = (end > capacity ? end - capacity : 0);
+      const size_t firstCopied = out.size();
+      for (uint64_t i = begin; i < end; i++)
+         out.push_back(events_[i & (capacity - 1)]);
+
+      // The writer kept going while we copied, anything it may have lapped (including the slot it is writing now) is dropped.
+      // The fence keeps the copies above from moving after the count is read again, an acquire load alone doesn't.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint64_t after = write_count_.load(std::memory_order_relaxed);
+      const uint64_t firstValid = (after >= capacity ? after - capacity + 1 : 0);
+      if (firstValid > begin)
+      {
+         const size_t lapped = (firstValid - begin < end - begin ? firstValid - begin : end - begin);
+         out.erase(out.begin() + firstCopied, out.begin() + firstCopied + lapped);
+      }
+   }
+
+private:
+   std::unique_ptr<TraceEvent[]> events_;
+   std::atomic<uint64_t> write_count_{ 0 };
+};
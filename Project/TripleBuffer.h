@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/// <summary>
+/// Lock-free triple buffer for handing the latest value from one writer thread to one reader thread.
+/// The writer fills WriteBuffer() then calls Publish(), the reader calls Consume() and reads ReadBuffer().
+/// Neither side ever waits, if the writer publishes faster than the reader consumes the older values are skipped.
+/// </summary>
+template <class T>
+class TripleBuffer
+{
+public:
+   // Writer side
+   T& WriteBuffer() { return buffers_[write_index_]; }
+
+   void Publish()
+   {
+      const uint8_t previous = shared_index_.exchange(write_index_ | fresh_bit, std::memory_order_acq_rel);
+      write_index_ = previous & index_mask;
+   }
+
+   // Reader side, returns true if a newer buffer has been published since the last call
+   bool Consume()
+   {
+      if ((shared_index_.load(std::memory_order_acquire) & fresh_bit) == 0)
+         return false;
+      const uint8_t previous = shared_index_.exchange(read_index_, std::memory_order_acq_rel);
+      read_index_ = previous & index_mask;
+      return true;
+   }
+
+   const T& ReadBuffer() const { return buffers_[read_index_]; }
+
+private:
+   static constexpr uint8_t index_mask = 0x3;
+   static constexpr uint8_t fresh_bit = 0x4;
+
+   T buffers_[3];
+   // Only touched by the writer
+   uint8_t write_index_ = 0;
+   // Only touched by the reader
+   uint8_t read_index_ = 1;
+   // Buffer waiting to be swapped between the two, with fresh_bit set if it hasn't been consumed
+   std::atomic<uint8_t> shared_index_{ 2 };
+};
@@ -1,6 +1,8 @@
 #pragma once
+#include <type_traits>
 /// <summary>
 /// Container class that has 2 floats
+/// Plain value type, see IVec2.
 /// </summary>
 struct Vec2
 {
@@ -8,37 +10,37 @@ public:
    float x = 0.0f;
    float y = 0.0f;
 
-   Vec2(float x, float y)
+   constexpr Vec2() = default;
+
+   constexpr Vec2(const float x, const float y) : x(x), y(y)
    {
-      this->x = x;
-      this->y = y;
    }
 
-   Vec2()
+   constexpr Vec2 operator +(const Vec2& other) const
    {
-   };
+      return Vec2(x + other.x, y + other.y);
+   }
 
-   Vec2 operator +(Vec2 other)
+   constexpr Vec2 operator -(const Vec2& other) const
    {
-      this->x + other.x;
-      this->y + other.y;
+      return Vec2(x - other.x, y - other.y);
    }
 
-   Vec2 operator =(Vec2 other)
+   constexpr Vec2 operator *(const float rhs) const
    {
-      this->x = other.x;
-      this->y = other.y;
+      return Vec2(x * rhs, y * rhs);
    }
 
-   static Vec2 Zero() { return Vec2(0, 0); };
-   static Vec2 Left() { return Vec2(-1, 0); };
-   static Vec2 Right() { return Vec2(1, 0); };
-   static Vec2 Up() { return Vec2(0, 1); };
-   static Vec2 Down() { return Vec2(0, -1); };
+   static constexpr Vec2 Zero() { return Vec2(0, 0); };
+   static constexpr Vec2 Left() { return Vec2(-1, 0); };
+   static constexpr Vec2 Right() { return Vec2(1, 0); };
+   static constexpr Vec2 Up() { return Vec2(0, 1); };
+   static constexpr Vec2 Down() { return Vec2(0, -1); };
 
    template <class Archive>
    void serialize(Archive& archive)
    {
       archive(x, y);
    }
-};
\ No newline at end of file
+};
+static_assert(std::is_trivially_copyable<Vec2>::value, "Vec2 is passed around by value and copied with memcpy");
@@ -7,9 +7,25 @@
 #include "ConfigFile.h"
 
 #include "Game.h"
+#include "Match3Benchmark.h"
+#include "Replay.h"
+#include "SessionServer.h"
 #include <iostream>
 
+#if defined(__linux__)
+// Headless contexts come from EGL, keep X11 out of it as there may be no display server at all
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+EGLDisplay g_egl_display = EGL_NO_DISPLAY;
+EGLContext g_egl_context = EGL_NO_CONTEXT;
+EGLSurface g_egl_surface = EGL_NO_SURFACE;
+#endif
+
 bool CreateWindowAndContext(GameSettings* settings);
+bool CreateHeadlessContext(GameSettings* settings);
+void DestroyHeadlessContext();
 
 SDL_GLContext g_context;
 SDL_Window* g_window;
@@ -26,28 +42,87 @@ int main(int argc, char** argv)
    printf("Loading config file..\n");
    ConfigFile config;
    config.StartLoad(config.FilePath().c_str(), true);
+   // Written back so the file lists every setting, including ones added since it was saved
+   if (config.has_missing_keys)
+      config.StartSave(config.FilePath().c_str());
 
    // Generate our game settings with the Serialized config file
    GameSettings* settings = new GameSettings();
    settings->LoadSettings(config);
 
-   if (!CreateWindowAndContext(settings))
+   // Command line overrides the config
+   for (int i = 1; i < argc; i++)
+   {
+      if (!settings->LoadArgument(argv[i]))
+         printf("Unknown argument: %s\n", argv[i]);
+   }
+
+   // No window or GL needed
+   if (settings->benchmark)
+      return Match3Benchmark(settings).Run();
+   // Replays are played back without rendering, so they don't need a window either
+   if (!settings->replay_path.empty())
+      return ReplayReader::Run(settings);
+   // Sessions are all headless too
+   if (!settings->serve_address.empty())
+      return SessionServer::Run(settings);
+
+   if (!(settings->headless ? CreateHeadlessContext(settings) : CreateWindowAndContext(settings)))
       success = false;
 
+   int exitCode = 0;
    game = new Game();
    if (!success || !game->Initialize(&g_context, g_window, settings))
    {
       printf("Failed to Initialize");
       success = false;
+      exitCode = 1;
+   }
+   else if (settings->headless)
+   {
+      exitCode = game->RunHeadless();
    }
    else
    {
       game->Run();
    }
 
-   SDL_DestroyWindow(g_window);
-   SDL_Quit();
-   return 0;
+   if (settings->headless)
+   {
+      DestroyHeadlessContext();
+   }
+   else
+   {
+      SDL_DestroyWindow(g_window);
+      SDL_Quit();
+   }
+   return exitCode;
+}
+
+void SetSwapInterval(GameSettings* settings)
+{
+   switch (settings->frame_pacing_mode)
+   {
+   case FramePacingMode::AdaptiveVSync:
+      if (SDL_GL_SetSwapInterval(-1) == 0)
+         break;
+      printf("Warning: Adaptive VSync not supported, falling back to VSync. SDL Error: %s\n", SDL_GetError());
+      settings->frame_pacing_mode = FramePacingMode::VSync;
+      // Fall through
+   case FramePacingMode::VSync:
+      if (SDL_GL_SetSwapInterval(1) < 0)
+      {
+         printf("Warning: Unable to set VSync! SDL Error: %s\n", SDL_GetError());
+      }
+      break;
+   case FramePacingMode::Uncapped:
+   case FramePacingMode::Capped:
+      if (SDL_GL_SetSwapInterval(0) < 0)
+      {
+         printf("Warning: Unable to disable VSync! SDL Error: %s\n", SDL_GetError());
+      }
+      break;
+   }
 }
 
 bool CreateWindowAndContext(GameSettings* settings)
@@ -73,11 +148,7 @@ bool CreateWindowAndContext(GameSettings* settings)
    }
    else
    {
-      // Vsync cause we're bad
-      if (SDL_GL_SetSwapInterval(1) < 0)
-      {
-         printf("Warning: Unable to set VSync! SDL Error: %s\n", SDL_GetError());
-      }
+      SetSwapInterval(settings);
       glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
    }
    // Init glew, has to be done after context
@@ -90,4 +161,102 @@ bool CreateWindowAndContext(GameSettings* settings)
    }
    std::cerr << "Status: Using GLEW " << glewGetString(GLEW_VERSION) << std::endl;
    return success;
+}
+
+/// <summary>
+/// Creates an OpenGL 3.3 Core context with no window, for build servers with no display or GPU.
+/// Prefers Mesa's surfaceless platform, falls back to the default display with a pbuffer if needed.
+/// Rendering goes into an offscreen FrameBuffer created by Game.
+/// </summary>
+bool CreateHeadlessContext(GameSettings* settings)
+{
+#if defined(__linux__)
+   g_context = nullptr;
+   g_window = nullptr;
+
+   const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+   if (getPlatformDisplay != nullptr)
+      g_egl_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+   if (g_egl_display == EGL_NO_DISPLAY)
+      g_egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+   EGLint major, minor;
+   if (g_egl_display == EGL_NO_DISPLAY || !eglInitialize(g_egl_display, &major, &minor))
+   {
+      printf("Unable to initialize EGL! EGL Err: 0x%x\n", eglGetError());
+      return false;
+   }
+   printf("Using EGL %i.%i (%s)\n", major, minor, eglQueryString(g_egl_display, EGL_VENDOR));
+
+   const EGLint configAttributes[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+      EGL_NONE
+   };
+   EGLConfig config;
+   EGLint configCount = 0;
+   if (!eglChooseConfig(g_egl_display, configAttributes, &config, 1, &configCount) || configCount == 0)
+   {
+      printf("No suitable EGL config! EGL Err: 0x%x\n", eglGetError());
+      return false;
+   }
+
+   eglBindAPI(EGL_OPENGL_API);
+   const EGLint contextAttributes[] = {
+      EGL_CONTEXT_MAJOR_VERSION, 3,
+      EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE
+   };
+   g_egl_context = eglCreateContext(g_egl_display, config, EGL_NO_CONTEXT, contextAttributes);
+   if (g_egl_context == EGL_NO_CONTEXT)
+   {
+      printf("OpenGL context could not be created! EGL Err: 0x%x\n", eglGetError());
+      return false;
+   }
+
+   // Surfaceless needs EGL_KHR_surfaceless_context, otherwise a tiny pbuffer keeps the context happy
+   const char* extensions = eglQueryString(g_egl_display, EGL_EXTENSIONS);
+   if (extensions == nullptr || strstr(extensions, "EGL_KHR_surfaceless_context") == nullptr)
+   {
+      const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+      g_egl_surface = eglCreatePbufferSurface(g_egl_display, config, pbufferAttributes);
+   }
+   if (!eglMakeCurrent(g_egl_display, g_egl_surface, g_egl_surface, g_egl_context))
+   {
+      printf("Unable to make EGL context current! EGL Err: 0x%x\n", eglGetError());
+      return false;
+   }
+
+   // Core profile needs this for GLEW to load everything
+   glewExperimental = GL_TRUE;
+   const GLenum err = glewInit();
+   // A GLEW built for GLX complains about the missing X display, but the GL entry points are already loaded by then
+   if (GLEW_OK != err && GLEW_ERROR_NO_GLX_DISPLAY != err)
+   {
+      std::cerr << "Error: " << glewGetErrorString(err) << std::endl;
+      return false;
+   }
+   printf("Headless renderer: %s\n", glGetString(GL_RENDERER));
+   glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+   return true;
+#else
+   printf("Headless mode requires EGL, which is only supported on Linux builds.\n");
+   return false;
+#endif
+}
+
+void DestroyHeadlessContext()
+{
+#if defined(__linux__)
+   if (g_egl_display == EGL_NO_DISPLAY)
+      return;
+   eglMakeCurrent(g_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+   if (g_egl_surface != EGL_NO_SURFACE)
+      eglDestroySurface(g_egl_display, g_egl_surface);
+   if (g_egl_context != EGL_NO_CONTEXT)
+      eglDestroyContext(g_egl_display, g_egl_context);
+   eglTerminate(g_egl_display);
+#endif
 }
\ No newline at end of file
@@ -4,10 +4,7 @@ out vec4 FragColor;
 in vec4 ourColor;
 in vec2 TexCoord;
 
-// texture samplers
-uniform sampler2D ourTexture;
-
 void main()
 {
-	FragColor = texture(ourTexture, TexCoord);
+	FragColor = ourColor;
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#version 330 core
+out vec4 FragColor;
+
+// One texel per cell, holding the CellType
+uniform isampler2D board;
+uniform ivec2 boardSize;
+uniform vec4 palette[10];
+
+// Layout in pixels, measured from the top left of the screen
+uniform vec2 boardOrigin;
+uniform float cellPitch;
+uniform float cellSize;
+uniform float screenHeight;
+
+uniform ivec2 movedFrom;
+uniform ivec2 movedTo;
+
+bool IsValidCell(ivec2 cell)
+{
+	return cell.x >= 0 && cell.y >= 0 && cell.x < boardSize.x && cell.y < boardSize.y;
+}
+
+// Moved cells are drawn 1.5x larger, so they can cover some of the spacing around them
+bool InHighlight(vec2 position, ivec2 cell)
+{
+	if (!IsValidCell(cell))
+		return false;
+	vec2 centre = vec2(cell) * cellPitch + cellSize * 0.5;
+	vec2 offset = abs(position - centre);
+	return max(offset.x, offset.y) < cellSize * 0.75;
+}
+
+void main()
+{
+	vec2 position = vec2(gl_FragCoord.x, screenHeight - gl_FragCoord.y) - boardOrigin;
+
+	ivec2 cell;
+	if (InHighlight(position, movedFrom))
+		cell = movedFrom;
+	else if (InHighlight(position, movedTo))
+		cell = movedTo;
+	else
+	{
+		cell = ivec2(floor(position / cellPitch));
+		vec2 local = position - vec2(cell) * cellPitch;
+		if (!IsValidCell(cell) || local.x >= cellSize || local.y >= cellSize)
+			discard;
+	}
+
+	FragColor = palette[texelFetch(board, cell, 0).r];
+}
\ No newline at end of file
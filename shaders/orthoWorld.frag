@@ -1,13 +1,10 @@
 #version 330 core
 out vec4 FragColor;
 
-in vec3 ourColor;
+in vec4 ourColor;
 in vec2 TexCoord;
 
-// texture samplers
-uniform sampler2D ourTexture;
-
 void main()
 {
-	FragColor = texture(ourTexture, TexCoord);
+	FragColor = ourColor;
 }
\ No newline at end of file
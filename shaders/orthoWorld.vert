@@ -1,15 +1,35 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+// Per instance, cells move and resize from start to end over duration, starting at start time
+layout (location = 2) in vec4 aPositions; // start xy, end xy
+layout (location = 3) in vec4 aTiming; // start time, duration, start size, end size
+layout (location = 4) in int aEasing;
+layout (location = 5) in vec4 aColour;
 
-out vec3 ourColor;
+out vec4 ourColor;
 out vec2 TexCoord;
 
-uniform mat4 model;
 uniform mat4 projection;
+// Milliseconds, the same clock as the start times
+uniform float time;
+
+// Matches BoardRenderer::Easing
+float Ease(int easing, float t)
+{
+	if (easing == 1)
+		return 1.0 - pow(1.0 - t, 3.0);
+	return t;
+}
 
 void main()
 {
-	gl_Position = projection * model * vec4(aPos, 1.0);
+	float t = aTiming.y > 0.0 ? clamp((time - aTiming.x) / aTiming.y, 0.0, 1.0) : 1.0;
+	t = Ease(aEasing, t);
+	vec2 centre = mix(aPositions.xy, aPositions.zw, t);
+	float size = mix(aTiming.z, aTiming.w, t);
+
+	gl_Position = projection * vec4(centre + aPos.xy * size, 1.0, 1.0);
+	ourColor = aColour;
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
\ No newline at end of file